@@ -0,0 +1,120 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief Content addressed cache of processed images, kept as files in a directory.
+ *
+ * Results are named after a hash of the contents of the input file and the parameters they were computed with, so
+ * an image replaced under the same name, or processed with other parameters, never hits a stale result. Results are
+ * written to a temporary file and renamed into place, readers (and other processes sharing the directory) only ever
+ * see complete files. The directory is kept under a byte budget by removing the least recently used results, the
+ * last use being the modification time of every file, so the order survives restarts.
+ */
+class ResultCache
+{
+  public:
+    /**
+     * @brief Writes a result to the given path, returns whether it succeeded.
+     */
+    using Writer = std::function<bool(const std::string& path)>;
+
+    /**
+     * @brief Constructor of the ResultCache class.
+     *
+     * @param directory Directory of the results, with a trailing slash. It must exist.
+     * @param extension Extension of the result files, files with other extensions are never touched.
+     * @param capacityBytes Budget of the bytes of all the results together.
+     */
+    ResultCache(const std::string& directory, const std::string& extension, uintmax_t capacityBytes);
+
+    /**
+     * @brief Builds the key of a result.
+     *
+     * The content hash of every input is remembered by path, inode, size and nanosecond modification and status
+     * change times, so only new or changed files are read, even if they are replaced within the same second.
+     *
+     * @param inputPath Path of the input file.
+     * @param parameters Every parameter the result depends on, as a file name friendly string.
+     * @return The key, or an empty string if the input can not be read.
+     */
+    std::string key(const std::string& inputPath, const std::string& parameters);
+
+    /**
+     * @brief Gets the path of the result file of a key, whether it exists or not.
+     * @param key The key of the result.
+     * @return The path of the result.
+     */
+    std::string path(const std::string& key) const;
+
+    /**
+     * @brief Looks a result up, marking it as the most recently used.
+     * @param key The key of the result.
+     * @return Whether the result exists.
+     */
+    bool lookup(const std::string& key);
+
+    /**
+     * @brief Writes a result and publishes it atomically, then evicts results over the budget.
+     *
+     * @param key The key of the result.
+     * @param writer Writes the result to the temporary path it is given.
+     * @return Whether the result was written and published. A failed write leaves no file behind.
+     */
+    bool publish(const std::string& key, const Writer& writer);
+
+    /**
+     * @brief Age after which a temporary file is removed even if the process that writes it still runs.
+     */
+    static constexpr std::chrono::hours STALE_TEMPORARY_AGE {1};
+
+    /**
+     * @brief Removes the least recently used results until the directory fits in the budget.
+     *
+     * Temporary files left behind by writers that died, or older than STALE_TEMPORARY_AGE, are removed too.
+     *
+     * @param keep Key of a result never removed, usually the one just published. Empty to consider them all.
+     * @return The bytes of the results left.
+     */
+    uintmax_t evict(const std::string& keep = "");
+
+  private:
+    /**
+     * @brief Checks whether a temporary file of publish() was abandoned.
+     * @param entry The temporary file.
+     * @param suffix What follows ".tmp" in its name, the pid of the writer and a counter.
+     * @return Whether its writer is gone or it is older than STALE_TEMPORARY_AGE.
+     */
+    static bool isStaleTemporary(const std::filesystem::directory_entry& entry, const std::string& suffix);
+
+    std::string directory_;
+    std::string extension_;
+    uintmax_t capacityBytes_;
+
+    /**
+     * @brief Content hash of a file, with the stat fields the file had when it was hashed.
+     */
+    struct HashedFile
+    {
+        ino_t inode;
+        uintmax_t size;
+        timespec modified;
+        timespec changed;
+        std::string hash;
+    };
+
+    /**
+     * @brief Content hashes by path.
+     */
+    std::map<std::string, HashedFile> hashes_;
+};
+
+#endif // RESULT_CACHE_HPP
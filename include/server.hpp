@@ -2,9 +2,11 @@
 #define SERVER_HPP
 
 #include "cannyEdgeFilter.hpp"
+#include "edgeMapCodec.hpp"
 #include "httplib.h"
 //#include "rocksDbWrapper.hpp"
 #include "myRocksDbWrapper.hpp"
+#include "resultCache.hpp"
 #include "socketSetup.hpp"
 #include "utils.hpp"
 #include <nlohmann/json.hpp>
@@ -16,11 +18,19 @@
 #include <csignal>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sched.h>
+#include <set>
+#include <sys/inotify.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <vector>
@@ -34,6 +44,7 @@
 #define BUFFER_64 64
 #define SECONDS_IN_MINUTE 60
 #define ADMIN_USER "ubuntu"
+#define CANNY_FRAME_HEADER_BYTES 4 // Big endian length prefix of every frame of a streamed Canny result
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
@@ -48,6 +59,19 @@ extern "C"
 constexpr int MAX_TCP_CONNECTIONS = 10;
 constexpr int MAX_UDP_CONNECTIONS = 10;
 
+/**
+ * @brief Parameters of a Canny result.
+ */
+struct CannyParameters
+{
+    float sigma;               /**< Standard deviation of the Gaussian blur. */
+    int kernelSize;            /**< Side of the Gaussian kernel. */
+    float lowThreshold;        /**< Weak edge threshold. */
+    float highThreshold;       /**< Strong edge threshold. */
+    std::string thresholdMode; /**< "fixed", "otsu" or "percentile". */
+    int previewSize;           /**< Longest side of a preview, 0 for the full resolution result. */
+};
+
 /**
  * @brief Enumeration representing the address family (IPv4 or IPv6).
  */
@@ -126,6 +150,12 @@ class Server
      */
     void stop();
 
+    /**
+     * @brief Sets where the threads of the Canny edge filter are pinned, see NumaPlacement.
+     * @param affinity The thread affinity, ThreadAffinity::None by default.
+     */
+    void setCannyAffinity(ThreadAffinity affinity);
+
     // private:
     /**
      * @brief Prefix for keys related to alerts.
@@ -186,9 +216,31 @@ class Server
     const std::string CONVERTION_OUT_PATH = "../img/outputImg/";
 
     /**
-     * @brief Name of the Canny result image.
+     * @brief Extension of the compressed Canny results, bit-packed edge maps (EdgeMapCodec) in gzip.
+     */
+    const std::string CANNY_RESULT_EXTENSION = ".edg.gz";
+
+    /**
+     * @brief Gaussian sigma used when an image selection request doesn't set one.
+     */
+    const float CANNY_DEFAULT_SIGMA = 1.0;
+
+    /**
+     * @brief Gaussian kernel size used when an image selection request doesn't set one.
+     */
+    const int CANNY_DEFAULT_KERNEL_SIZE = KERNEL_SIZE;
+
+    /**
+     * @brief Budget in bytes of the cached Canny results in ZIP_PATH, the least recently used ones are removed beyond
+     * it.
      */
-    const std::string CANNY_RESULT = "canny.png";
+    const uintmax_t CANNY_CACHE_CAPACITY = 1024ULL * 1024 * 1024;
+
+    /**
+     * @brief Hysteresis thresholds used when an image selection request doesn't set them.
+     */
+    const float CANNY_DEFAULT_LOW_THRESHOLD = 40.0;
+    const float CANNY_DEFAULT_HIGH_THRESHOLD = 80.0;
 
     /**
      * @brief Path to the alerts FIFO.
@@ -200,6 +252,11 @@ class Server
      */
     const int REST_API_PORT = 8011;
 
+    /**
+     * @brief Minimum time between two catch ups of the REST secondary database with the primary.
+     */
+    const std::chrono::milliseconds REST_CATCH_UP_INTERVAL{100};
+
     /**
      * @brief TCP port.
      */
@@ -210,6 +267,8 @@ class Server
      */
     int udp_port_;
 
+    ThreadAffinity cannyAffinity_ = ThreadAffinity::None;
+
     /**
      * @brief Flag indicating if the server is running.
      */
@@ -235,6 +294,31 @@ class Server
      */
     pid_t restListener;
 
+    /**
+     * @brief Process ID for the background Canny precomputation.
+     */
+    pid_t precomputePid;
+
+    /**
+     * @brief Canny results in ZIP_PATH, by content hash of the image and parameters. Created by start().
+     */
+    std::unique_ptr<ResultCache> resultCache;
+
+    /**
+     * @brief Secondary RocksDB instance shared by the REST handlers of the REST listener process.
+     */
+    std::unique_ptr<RocksDbWrapper> restDbWrapper;
+
+    /**
+     * @brief Protects the lazy opening and the catch ups of the REST secondary database.
+     */
+    std::mutex restDbMutex;
+
+    /**
+     * @brief Last time the REST secondary database caught up with the primary.
+     */
+    std::chrono::steady_clock::time_point restDbLastCatchUp;
+
     /**
      * @brief Count of entry alerts.
      */
@@ -587,6 +671,28 @@ class Server
      */
     void createRestListenerProcess();
 
+    /**
+     * @brief Creates a process precomputing the Canny results of the images in IMAGE_PATH.
+     *
+     * The child process watches IMAGE_PATH with inotify and queues every image written or moved into it, plus the
+     * ones already there at start up, then computes their default preview and full resolution results into the
+     * result cache, so the first client selecting an image usually finds it ready. It runs with the SCHED_IDLE policy
+     * and the idle I/O class, only taking cores and disk time nothing else wants. Bursts of events for the same
+     * image are queued once. The parent process continues its execution without waiting for the child process to
+     * finish.
+     */
+    void createPrecomputeProcess();
+
+    /**
+     * @brief Computes the default Canny results of an image that are not cached yet.
+     *
+     * Nothing is kept in memory for later: the post-NMS maps skip the SuppressionCache and the WorkspacePool buffers
+     * are freed once the image is done.
+     *
+     * @param imageName The name of the image in IMAGE_PATH.
+     */
+    void precomputeCannyResults(const std::string& imageName);
+
     /**
      * @brief Handles REST API requests for alerts data.
      *
@@ -612,17 +718,69 @@ class Server
     void handleRestSupplies(const httplib::Request& req, httplib::Response& res);
 
     /**
-     * @brief Sends a file to a client over a socket connection.
+     * @brief Retrieves the database instance used to serve REST API requests.
+     *
+     * The REST listener never opens the database read-write, because the main process owns the primary instance and
+     * its LOCK file. Instead, the database is opened once as a RocksDB secondary instance, which is brought up to date
+     * with the primary on demand, at most once every REST_CATCH_UP_INTERVAL.
+     *
+     * @return A reference to the secondary database instance.
+     *
+     * @throws std::runtime_error If the secondary instance can't be opened.
+     */
+    RocksDbWrapper& getRestDatabase();
+
+    /**
+     * @brief Sends a file to a client over a socket connection, as a stream of frames.
      *
-     * This method opens the specified file in binary mode and reads its content into a buffer.
-     * It then sends the file content through the specified socket connection.
-     * If the file cannot be opened or if there's an error sending the file content, appropriate error messages are
-     * printed.
+     * The file is read and sent COMPRESS_CHUNK_BYTES at a time, every piece in its own frame, and the stream is ended
+     * with an empty frame, so it never is fully in memory. If the file cannot be opened or a read fails, the stream is
+     * ended early and the client sees a truncated result.
      *
      * @param client_fd The file descriptor of the socket connection to the client.
      * @param file_path The path to the file to be sent.
+     * @return Whether the whole file was sent.
+     */
+    bool sendFileToClient(int client_fd, const std::string& file_path);
+
+    /**
+     * @brief Sends one frame of a streamed result: its length in CANNY_FRAME_HEADER_BYTES, big endian, and its bytes.
+     *
+     * Partial sends are retried until the whole frame is out. An empty frame ends the stream.
+     *
+     * @param client_fd The file descriptor of the socket connection to the client.
+     * @param data The bytes of the frame.
+     * @param size The number of bytes, at most UINT32_MAX.
+     * @return Whether the frame was sent, false if the client went away.
+     */
+    bool sendFrameToClient(int client_fd, const unsigned char* data, size_t size);
+
+    /**
+     * @brief Builds the parameters part of the ResultCache key of a Canny result.
+     * @param parameters The parameters of the result.
+     * @return Every parameter, as a file name friendly string.
+     */
+    static std::string cannyResultParameters(const CannyParameters& parameters);
+
+    /**
+     * @brief Runs the Canny edge filter over an image and publishes the compressed edge map in the result cache.
+     *
+     * Every gzip member is handed to the stream as soon as it is compressed, in order, while it is also written to the
+     * cache, so a client receives the first bytes after a single chunk has been compressed instead of after the whole
+     * result is on disk. The stream may fail without affecting the cache, and the other way round.
+     *
+     * @param imagePath The path of the image.
+     * @param resultKey The ResultCache key of the result.
+     * @param parameters The parameters of the result.
+     * @param stream Optional sink of the compressed result, called from the calling thread. Once it returns false it
+     * isn't called again.
+     * @param cacheSuppression Whether the post-NMS map is kept in the SuppressionCache, for requests that may
+     * re-threshold the image. Precomputing never does.
+     * @return Whether the result was published, false if the image can not be processed or saved.
      */
-    void sendFileToClient(int client_fd, const std::string& file_path);
+    bool computeCannyResult(const std::string& imagePath, const std::string& resultKey,
+                            const CannyParameters& parameters, const Utils::ChunkWriter& stream = nullptr,
+                            bool cacheSuppression = true);
 
     /**
      * @brief Retrieves the last ID stored in the database for the given key.
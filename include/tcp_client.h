@@ -16,6 +16,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #define SERVER_IP_V4_LOOP "127.0.0.1"
 #define SERVER_IP_V6_LOOP "::1"
@@ -25,7 +26,14 @@
 #define OS_RELEASE_PATH "/etc/os-release"
 #define OS_RELEASE_ID_FIELD 3
 #define SOCK_PATH "/tmp/client_unix_sock"
-#define SAVE_ZIP_PATH "./cannyResult.zip"
+#define SAVE_EDGES_PATH "./cannyResult.pbm"
+#define SAVE_PREVIEW_EDGES_PATH "./cannyPreview.pbm"
+#define EDGE_MAP_HEADER_BYTES 24
+#define EDGE_MAP_VERSION 1
+#define EDGE_MAP_ENCODING_PACKED 0
+#define EDGE_MAP_ENCODING_ZERO_RUNS 1
+#define EDGE_MAP_FRAME_HEADER_BYTES 4
+#define EDGE_MAP_MAX_FRAME_BYTES (1024 * 1024)
 
 /**
  * @brief Structure to store the TCP and UDP port numbers.
@@ -201,8 +209,30 @@ void authenticate(int sockfd);
 int do_connect(char* server, char* port);
 
 /**
- * @brief Receives a ZIP file from the server through the provided socket and writes it to the specified file path.
- * @param sockfd The socket file descriptor connected to the server from which to receive the ZIP file.
- * @param file_path The path to the file where the received ZIP file will be written.
+ * @brief Receives a streamed edge map from the server and saves it as a PBM image.
+ *
+ * The server sends the gzipped edge map in frames, each one a 4-byte big endian length and that many bytes, ended by
+ * an empty frame. The gzip stream may be made of several members. Frames are inflated as they arrive, so the edge map
+ * is never written to disk compressed.
+ *
+ * @param sockfd The socket file descriptor connected to the server.
+ * @param pending Bytes of the stream already read from the socket along with the announcement.
+ * @param pending_size The number of pending bytes.
+ * @param pbm_path The path of the PBM image to write.
+ * @return 0 on success, -1 if the stream is cut short or is not a valid edge map.
+ */
+int receive_edge_map(int sockfd, const char* pending, size_t pending_size, const char* pbm_path);
+
+/**
+ * @brief Decodes a received edge map into a PBM (P4) image, edges in black.
+ *
+ * The server sends the edge map gzipped, in the bit-packed format of EdgeMapCodec: a 24-byte header ("EDGM", version,
+ * encoding, reserved, columns, rows and payload bytes, little endian) and the packed rows, optionally with the runs of
+ * zero bytes replaced by varint tokens. Expanded, the rows are already the body of a PBM image.
+ *
+ * @param data The inflated edge map.
+ * @param size The number of bytes of the edge map.
+ * @param pbm_path The path of the PBM image to write.
+ * @return 0 on success, -1 if the data is not a valid edge map or the image can not be written.
  */
-void receive_zip(int sockfd, const char* file_path);
+int decode_edge_map(const unsigned char* data, size_t size, const char* pbm_path);
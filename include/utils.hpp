@@ -8,18 +8,22 @@
 #include <ctime>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <nlohmann/json.hpp>
 #include <openssl/sha.h>
 #include <string>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <vector>
 //#include <zip.h>
 #include <zlib.h>
 
 #define LOG_FILENAME "refuge_lab2.log"
 #define REFUGE_DIR "/.refuge/"
 #define DB_NAME "../build/database"
+#define DB_SECONDARY_NAME "../build/database_rest"
+#define COMPRESS_CHUNK_BYTES (256 * 1024)
 
 using json = nlohmann::json;
 
@@ -86,6 +90,17 @@ bool fileExists(const std::string& directory, const std::string& filename);
  */
 int getFileSize(const std::string& zipPath);
 
+/**
+ * @brief Hashes the contents of a file.
+ *
+ * A fast non cryptographic 64-bit hash, reading the file in large chunks and mixing 8-byte words in four independent
+ * lanes. It tells files apart, it doesn't protect against crafted collisions.
+ *
+ * @param filePath The path of the file.
+ * @return The hash as 16 hexadecimal digits, or an empty string if the file can not be read.
+ */
+std::string hashFile(const std::string& filePath);
+
 /**
  * @brief Deletes a directory and its contents.
  *
@@ -156,6 +171,40 @@ std::vector<std::string> findAvailableImages(const std::string& directoryPath);
  */
 bool compressImg(const std::string& imagePath, const std::string& zipPath);
 
+/**
+ * @brief Compresses an encoded image held in memory into a ZIP archive.
+ *
+ * The archive is a multi-member gzip stream compressed in parallel by gzipChunks(), any zlib reader decompresses it.
+ *
+ * @param imageData The encoded image bytes to be compressed.
+ * @param zipPath The path to the ZIP archive to be created.
+ * @return True if the compression is successful, false otherwise.
+ */
+bool compressImg(const std::vector<unsigned char>& imageData, const std::string& zipPath);
+
+/**
+ * @brief Writes a chunk of output, returns whether it succeeded.
+ */
+using ChunkWriter = std::function<bool(const unsigned char* data, size_t size)>;
+
+/**
+ * @brief Compresses a buffer into a gzip stream, chunks in parallel.
+ *
+ * The input is split in chunks of COMPRESS_CHUNK_BYTES, each compressed into a complete gzip member, like pigz does,
+ * by a pool of threads started on the first call of the process and shared by every later one. Concatenated gzip
+ * members are a valid gzip stream, gunzip and gzread() decompress them as a whole. The members are written in order
+ * from the calling thread as soon as they are ready. A call never has more chunks compressing than the threads it
+ * asks for, and only a few chunks per thread are compressed ahead of the writes, so the memory held and the queue of
+ * the pool are bounded and a slow writer throttles the compression.
+ *
+ * @param data The bytes to compress.
+ * @param size The number of bytes, an empty input still gives a valid (empty) gzip stream.
+ * @param write Receives the members in order.
+ * @param threads Chunks compressed at once, at most one per core and per chunk. 0 for one per core.
+ * @return True if every member was compressed and written, false otherwise. Nothing else is written after a failure.
+ */
+bool gzipChunks(const unsigned char* data, size_t size, const ChunkWriter& write, unsigned threads = 0);
+
 /**
  * @brief Class for generating unique IDs.
  */
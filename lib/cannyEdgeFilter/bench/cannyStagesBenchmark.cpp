@@ -0,0 +1,169 @@
+/*
+ * LuckyAlgorithmForSatellites - cannyEdgeFilter benchmark
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "cannyEdgeFilter.hpp"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <omp.h>
+
+namespace
+{
+constexpr float LOW_THRESHOLD = 40.0f;
+constexpr float HIGH_THRESHOLD = 80.0f;
+constexpr float SIGMA = 1.0f;
+
+// Square synthetic scene: flat fields with sharp borders, a smooth gradient and some hashed noise, so every stage
+// sees strong edges, weak chains and flat areas. Built once per side, the large ones take a while
+const cv::Mat& syntheticImage(int side)
+{
+    static std::map<int, cv::Mat> images;
+    cv::Mat& image = images[side];
+    if (image.empty())
+    {
+        image.create(side, side, CV_8U);
+        #pragma omp parallel for
+        for (int row = 0; row < side; ++row)
+        {
+            uint8_t* pixels = image.ptr<uint8_t>(row);
+            for (int col = 0; col < side; ++col)
+            {
+                const uint32_t hash =
+                    (static_cast<uint32_t>(row) * 73856093u) ^ (static_cast<uint32_t>(col) * 19349663u);
+                const int field = ((row / 97 + col / 131) % 3) * 70;
+                const int gradient = (col * 40) / side;
+                pixels[col] = static_cast<uint8_t>(30 + field + gradient + (hash >> 27));
+            }
+        }
+    }
+    return image;
+}
+
+// Arguments of every benchmark: image side from 512 to 16384, and thread counts from 1 to every core
+void sidesAndThreads(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({"side", "threads"});
+    const int cores = omp_get_num_procs();
+    for (int side = 512; side <= 16384; side *= 2)
+    {
+        for (int threads = 1; threads < cores; threads *= 2)
+        {
+            benchmark->Args({side, threads});
+        }
+        benchmark->Args({side, cores});
+    }
+}
+
+// Reported as pixels per second of the measured time
+void setThroughput(benchmark::State& state, int side)
+{
+    const double pixels = static_cast<double>(side) * side * state.iterations();
+    state.counters["pixels"] = benchmark::Counter(pixels, benchmark::Counter::kIsRate);
+}
+
+// Times a single stage of the pipeline, as reported by EdgeDetection::getStageTimes(), over full runs
+void BM_Stage(benchmark::State& state, PipelineMode mode, double StageTimes::*stage,
+              Precision precision = Precision::Float,
+              SobelKernels::GradientNorm norm = SobelKernels::GradientNorm::L2)
+{
+    const int side = static_cast<int>(state.range(0));
+    omp_set_num_threads(static_cast<int>(state.range(1)));
+    const cv::Mat& image = syntheticImage(side);
+
+    EdgeDetection edgeDetection(LOW_THRESHOLD, HIGH_THRESHOLD, SIGMA);
+    edgeDetection.setPipelineMode(mode);
+    edgeDetection.setPrecision(precision);
+    edgeDetection.setGradientNorm(norm);
+    edgeDetection.setTimers(false);
+    cv::Mat edges;
+    for (auto _ : state)
+    {
+        edgeDetection.cannyEdgeDetection(image, edges);
+        state.SetIterationTime(edgeDetection.getStageTimes().*stage);
+    }
+    setThroughput(state, side);
+}
+
+// Times the whole fused pipeline, the one used by the server, with the threads left to the OS or pinned
+void BM_Pipeline(benchmark::State& state, ThreadAffinity affinity, Precision precision = Precision::Float,
+                 SobelKernels::GradientNorm norm = SobelKernels::GradientNorm::L2)
+{
+    const int side = static_cast<int>(state.range(0));
+    omp_set_num_threads(static_cast<int>(state.range(1)));
+    const cv::Mat& image = syntheticImage(side);
+
+    EdgeDetection edgeDetection(LOW_THRESHOLD, HIGH_THRESHOLD, SIGMA);
+    edgeDetection.setThreadAffinity(affinity);
+    edgeDetection.setPrecision(precision);
+    edgeDetection.setGradientNorm(norm);
+    edgeDetection.setTimers(false);
+    cv::Mat edges;
+    for (auto _ : state)
+    {
+        edgeDetection.cannyEdgeDetection(image, edges);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    setThroughput(state, side);
+    NumaPlacement::pinThreads(ThreadAffinity::None);
+}
+} // namespace
+
+BENCHMARK_CAPTURE(BM_Stage, GaussianBlur, PipelineMode::Staged, &StageTimes::gaussianBlur)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Stage, GaussianBlurFixedPoint, PipelineMode::Staged, &StageTimes::gaussianBlur,
+                  Precision::FixedPoint)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Stage, Sobel, PipelineMode::Staged, &StageTimes::sobel)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Stage, SobelL1, PipelineMode::Staged, &StageTimes::sobel, Precision::Float,
+                  SobelKernels::GradientNorm::L1)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Stage, NonMaximumSuppression, PipelineMode::Staged, &StageTimes::nonMaximumSuppression)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Stage, FusedSuppression, PipelineMode::Fused, &StageTimes::fusedSuppression)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Stage, Hysteresis, PipelineMode::Fused, &StageTimes::hysteresis)
+    ->Apply(sidesAndThreads)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Pipeline, Unpinned, ThreadAffinity::None)
+    ->Apply(sidesAndThreads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Pipeline, NodeAffinity, ThreadAffinity::Node)
+    ->Apply(sidesAndThreads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Pipeline, FixedPoint, ThreadAffinity::None, Precision::FixedPoint)
+    ->Apply(sidesAndThreads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Pipeline, FixedPointL1, ThreadAffinity::None, Precision::FixedPoint,
+                  SobelKernels::GradientNorm::L1)
+    ->Apply(sidesAndThreads)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
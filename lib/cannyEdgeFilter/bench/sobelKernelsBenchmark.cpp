@@ -0,0 +1,62 @@
+/*
+ * LuckyAlgorithmForSatellites - sobelKernels benchmark
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "sobelKernels.hpp"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+using SobelKernels::SimdLevel;
+
+// Throughput of one Sobel row kernel over a synthetic image, single threaded
+static void BM_SobelRow(benchmark::State& state, SimdLevel level)
+{
+    if (level > SobelKernels::detectSimdLevel())
+    {
+        state.SkipWithError("Instruction set not supported by this CPU");
+        return;
+    }
+
+    const int side = static_cast<int>(state.range(0));
+    std::vector<uint8_t> image(static_cast<size_t>(side) * side);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for (auto& pixel : image)
+    {
+        pixel = static_cast<uint8_t>(distribution(generator));
+    }
+    std::vector<uint16_t> magnitude(side);
+    std::vector<uint8_t> direction(side);
+
+    const SobelKernels::SobelRowFn sobelRow = SobelKernels::getSobelRow(level);
+    for (auto _ : state)
+    {
+        for (int row = 1; row < side - 1; ++row)
+        {
+            sobelRow(&image[(row - 1) * side], &image[row * side], &image[(row + 1) * side], magnitude.data(),
+                     direction.data(), side);
+            benchmark::DoNotOptimize(magnitude.data());
+            benchmark::DoNotOptimize(direction.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * side * side);
+    state.SetLabel(SobelKernels::simdLevelName(level));
+}
+
+BENCHMARK_CAPTURE(BM_SobelRow, Scalar, SimdLevel::Scalar)->Arg(512)->Arg(2048)->Arg(4096);
+BENCHMARK_CAPTURE(BM_SobelRow, SSE4, SimdLevel::SSE4)->Arg(512)->Arg(2048)->Arg(4096);
+BENCHMARK_CAPTURE(BM_SobelRow, AVX2, SimdLevel::AVX2)->Arg(512)->Arg(2048)->Arg(4096);
+BENCHMARK_CAPTURE(BM_SobelRow, AVX512, SimdLevel::AVX512)->Arg(512)->Arg(2048)->Arg(4096);
@@ -0,0 +1,97 @@
+/*
+ * LuckyAlgorithmForSatellites - autoThreshold
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _AUTO_THRESHOLD_HPP
+#define _AUTO_THRESHOLD_HPP
+
+#include <opencv2/core/core.hpp>
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief Selection of the hysteresis thresholds from the edge strengths of the image itself.
+ *
+ * The thresholds are derived from the histogram of the non-maximum suppression output, ignoring its zeros, so they
+ * only depend on the pixels that can become edges. The low threshold is a fixed ratio of the high one and never
+ * below 1, so pixels without any gradient are never weak edges.
+ */
+namespace AutoThreshold
+{
+/**
+ * @brief Default ratio between the low and the high threshold.
+ */
+constexpr float DEFAULT_LOW_RATIO = 0.5f;
+
+/**
+ * @brief Default fraction of the candidate pixels below the high threshold for percentile().
+ */
+constexpr float DEFAULT_HIGH_PERCENTILE = 0.8f;
+
+/**
+ * @brief Rows skipped between the rows histogrammed by EdgeDetection.
+ *
+ * Millions of pixels after non-maximum suppression give the same thresholds as all of them, at a fraction of the
+ * cost of the pass.
+ */
+constexpr int SAMPLE_ROW_STEP = 4;
+
+/**
+ * @brief Pixel count of every 8-bit value.
+ */
+using Histogram = std::array<uint64_t, 256>;
+
+/**
+ * @brief A pair of hysteresis thresholds.
+ */
+struct Thresholds
+{
+    float low;  ///< Weak edge threshold.
+    float high; ///< Strong edge threshold.
+};
+
+/**
+ * @brief Builds the histogram of an 8-bit image in parallel.
+ *
+ * Every thread fills its own histogram over a block of rows and they are added up at the end. Zeros, most of the
+ * pixels after non-maximum suppression, are not counted one by one but derived from the total.
+ *
+ * @param image 8-bit single channel image.
+ * @param rowStep Only rows 0, rowStep, 2 * rowStep... are counted.
+ * @return The histogram.
+ */
+Histogram histogram(const cv::Mat& image, int rowStep = 1);
+
+/**
+ * @brief Selects the high threshold with Otsu's method over the non zero values.
+ * @param histogram Histogram of the edge strengths.
+ * @param lowRatio Ratio between the low and the high threshold.
+ * @return The thresholds. With no non zero value the high threshold is 255.
+ */
+Thresholds otsu(const Histogram& histogram, float lowRatio = DEFAULT_LOW_RATIO);
+
+/**
+ * @brief Selects the high threshold so that a fraction of the non zero values stay below it.
+ * @param histogram Histogram of the edge strengths.
+ * @param highPercentile Fraction of the non zero values below the high threshold, in [0, 1].
+ * @param lowRatio Ratio between the low and the high threshold.
+ * @return The thresholds. With no non zero value the high threshold is 255.
+ */
+Thresholds percentile(const Histogram& histogram,
+                      float highPercentile = DEFAULT_HIGH_PERCENTILE,
+                      float lowRatio = DEFAULT_LOW_RATIO);
+} // namespace AutoThreshold
+
+#endif /* _AUTO_THRESHOLD_HPP */
@@ -0,0 +1,119 @@
+/*
+ * LuckyAlgorithmForSatellites - batchEdgeDetection
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _BATCH_EDGE_DETECTION_HPP
+#define _BATCH_EDGE_DETECTION_HPP
+
+#include "cannyEdgeFilter.hpp"
+#include <opencv2/core/core.hpp>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Throughput of a batch run.
+ */
+struct BatchReport
+{
+    size_t images = 0;   ///< Images processed.
+    size_t pixels = 0;   ///< Pixels of all the images.
+    double seconds = 0;  ///< Wall time of the whole batch.
+
+    /**
+     * @brief Gets the images processed per second.
+     * @return The throughput, 0 for an empty batch.
+     */
+    double imagesPerSecond() const;
+
+    /**
+     * @brief Gets the millions of pixels processed per second.
+     * @return The throughput, 0 for an empty batch.
+     */
+    double megapixelsPerSecond() const;
+};
+
+/**
+ * @brief Runs Canny edge detection over many images, scheduling work across and within them.
+ *
+ * Small images don't have enough rows to keep every core busy, and the fork/join of every stage costs as much as the
+ * stage itself. They are processed as OpenMP tasks, one image per task, with the parallel loops inside each task
+ * limited to a single thread. Large images are processed one after the other, every stage using all the threads.
+ * The result of every image is the same as running EdgeDetection on it alone.
+ */
+class BatchEdgeDetection
+{
+public:
+    /**
+     * @brief Default size, in pixels, up to which an image is processed by a single thread.
+     */
+    static constexpr size_t DEFAULT_SMALL_IMAGE_PIXELS = 1024 * 1024;
+
+    /**
+     * @brief Constructor for the BatchEdgeDetection class.
+     *
+     * @param lowThreshold The lower threshold value for edge detection.
+     * @param highThreshold The higher threshold value for edge detection.
+     * @param sigma Standard deviation of the Gaussian kernel.
+     * @param kernelSize Side of the Gaussian kernel: 3, 5 or 7.
+     */
+    BatchEdgeDetection(float lowThreshold, float highThreshold, float sigma, int kernelSize = KERNEL_SIZE);
+
+    /**
+     * @brief Applies Canny edge detection to every image of a batch.
+     *
+     * Buffers in edges of the right size and type are reused. If any image fails the whole batch throws once every
+     * task has finished, with the error of the first failing image.
+     *
+     * @param images The input images, 8-bit single channel, of any sizes.
+     * @param edges Output edge maps, one per image in the same order, 255 for edges and 0 elsewhere.
+     * @return The throughput of the batch.
+     */
+    BatchReport process(const std::vector<cv::Mat>& images, std::vector<cv::Mat>& edges);
+
+    /**
+     * @brief Sets the size up to which an image is processed by a single thread.
+     * @param pixels Pixel count, 0 processes every image with all the threads.
+     */
+    void setSmallImagePixels(size_t pixels);
+
+    /**
+     * @brief Sets the number of threads of the batch.
+     * @param threads Thread count, 0 uses the OpenMP default (the default).
+     */
+    void setThreads(int threads);
+
+    /**
+     * @brief Enables printing the time and throughput of every batch. The stages of every image are never timed.
+     * @param enabled Whether the [TIMER] line is printed, true by default.
+     */
+    void setTimers(bool enabled);
+
+private:
+    float m_lowThreshold;
+    float m_highThreshold;
+    float m_sigma;
+    int m_kernelSize;
+    size_t m_smallImagePixels = DEFAULT_SMALL_IMAGE_PIXELS;
+    int m_threads = 0;
+    bool m_printTimers = true;
+
+    /**
+     * @brief Creates the detector used for one image, with the stage timers off.
+     * @return The detector.
+     */
+    EdgeDetection makeDetector() const;
+};
+
+#endif /* _BATCH_EDGE_DETECTION_HPP */
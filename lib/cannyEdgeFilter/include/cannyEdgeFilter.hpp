@@ -17,13 +17,99 @@
 #ifndef _CANNY_EDGE_FILTER_HPP
 #define _CANNY_EDGE_FILTER_HPP
 
+#include "autoThreshold.hpp"
+#include "hysteresis.hpp"
 #include "imageFileOperations.hpp"
+#include "numaPlacement.hpp"
+#include "sobelKernels.hpp"
+#include "suppressionCache.hpp"
+#include "workspacePool.hpp"
 #include <opencv2/core/core.hpp>
 #include <omp.h>
 #include <chrono>
+#include <vector>
 
+/**
+ * @brief Default side of the Gaussian blur kernel. Sizes 3, 5 and 7 are supported, each with its own compile time
+ * specialized loops.
+ */
 constexpr auto KERNEL_SIZE {3};
 
+/**
+ * @brief Fraction bits of the weights of the Precision::FixedPoint blur.
+ */
+constexpr auto BLUR_FRACTION_BITS {8};
+
+/**
+ * @brief Default longest side of the images processed by EdgeDetection::previewEdgeDetection().
+ */
+constexpr auto PREVIEW_MAX_SIDE {512};
+
+/**
+ * @brief How the stages of the Canny pipeline are scheduled.
+ */
+enum class PipelineMode
+{
+    /**
+     * Blur, Sobel and non-maximum suppression run over cache-sized strips of rows, keeping only a few rolling rows of
+     * every intermediate per thread. No full size intermediate image besides the suppressed edges is allocated.
+     */
+    Fused,
+    /**
+     * Every stage is a separate full image pass. The intermediate images are kept and saved, which is useful to
+     * inspect each stage.
+     */
+    Staged
+};
+
+/**
+ * @brief Arithmetic of the Gaussian blur.
+ */
+enum class Precision
+{
+    Float,     /**< Float weights and sums, the reference. */
+    /**
+     * Weights with 8 fraction bits summing to exactly one. The horizontal pass of 8-bit pixels fits uint16 and the
+     * vertical pass uint32, twice and four times the lanes of float. The blurred pixels differ by at most one
+     * level from the float ones, so a few edges along the thresholds may differ.
+     */
+    FixedPoint
+};
+
+/**
+ * @brief Where the hysteresis thresholds come from.
+ */
+enum class ThresholdMode
+{
+    Fixed,     /**< The thresholds given to the constructor. */
+    Otsu,      /**< Derived from the edge strengths of every image with AutoThreshold::otsu(). */
+    Percentile /**< Derived from the edge strengths of every image with AutoThreshold::percentile(). */
+};
+
+/**
+ * @brief How the gradients of several bands are merged before non-maximum suppression.
+ */
+enum class BandCombination
+{
+    Max,        /**< Per pixel, the largest weighted magnitude of any band. */
+    WeightedSum /**< Per pixel, the sum of the weighted magnitudes of all the bands. */
+};
+
+/**
+ * @brief Seconds taken by every stage of a Canny run. Stages that didn't run are 0.
+ */
+struct StageTimes
+{
+    double downsample = 0;            ///< Reduction of previewEdgeDetection().
+    double gaussianBlur = 0;          ///< Staged pipeline only.
+    double sobel = 0;                 ///< Staged pipeline only.
+    double nonMaximumSuppression = 0; ///< Staged pipeline only.
+    double fusedSuppression = 0;      ///< Blur, Sobel and non-maximum suppression of the fused pipeline.
+    double suppressionCache = 0;      ///< Hashing the image, looking its suppressed map up and storing it.
+    double thresholds = 0;            ///< Automatic threshold selection.
+    double hysteresis = 0;
+};
+
 /**
  * @brief The EdgeDetection class applies Canny edge detection to an image.
  */
@@ -36,41 +122,247 @@ public:
      * @param lowThreshold The lower threshold value for edge detection.
      * @param highThreshold The higher threshold value for edge detection.
      * @param sigma Standard deviation of the Gaussian kernel.
+     * @param kernelSize Side of the Gaussian kernel: 3, 5 or 7. Larger kernels smooth more noise out at a higher cost.
      */
-    EdgeDetection(float lowThreshold, float highThreshold, float sigma);
+    EdgeDetection(float lowThreshold, float highThreshold, float sigma, int kernelSize = KERNEL_SIZE);
 
     /**
-     * @brief Applies Canny edge detection to an image.
+     * @brief Applies Canny edge detection to an image in memory.
+     *
+     * No file is written unless a debug output directory was set with setDebugOutput().
+     *
+     * @param image The input image, 8-bit single channel.
+     * @return The edge map, 255 for edges and 0 elsewhere.
+     */
+    cv::Mat cannyEdgeDetection(const cv::Mat& image);
+
+    /**
+     * @brief Applies Canny edge detection to an image in memory, into a caller owned buffer.
+     *
+     * The working buffers come from WorkspacePool::instance(), and edges is only reallocated when its size or type
+     * doesn't match. Once a job of the same size has warmed the pool up, reusing the same edges buffer runs without
+     * heap allocations, also on a freshly constructed detector. A SuppressionCache miss still copies the suppressed
+     * map into the cache.
+     *
+     * @param image The input image, 8-bit single channel.
+     * @param edges Output edge map, 255 for edges and 0 elsewhere.
+     */
+    void cannyEdgeDetection(const cv::Mat& image, cv::Mat& edges);
+
+    /**
+     * @brief Applies Canny edge detection to a multispectral image.
+     *
+     * The gradient of every band is computed separately and merged before non-maximum suppression, which then runs
+     * on the combined magnitude. The direction of each pixel is the one of the band with the largest weighted
+     * magnitude. Strips of rows run in parallel, each one streaming all the bands, so this always uses the fused
+     * pipeline.
+     *
+     * @param bands The bands, 8-bit single channel images of the same size.
+     * @param edges Output edge map, 255 for edges and 0 elsewhere.
+     * @param combination How the band magnitudes are merged.
+     * @param weights One non negative weight per band. Empty means 1 for Max and 1 / bands for WeightedSum.
+     */
+    void cannyEdgeDetection(const std::vector<cv::Mat>& bands,
+                            cv::Mat& edges,
+                            BandCombination combination,
+                            const std::vector<float>& weights = {});
+
+    /**
+     * @brief Applies Canny edge detection to a reduced copy of an image, for fast previews.
+     *
+     * The image is shrunk by the smallest integer factor that fits its longest side in maxSide, averaging every
+     * block of factor x factor pixels, and the edges are detected on the reduced image. The cost is one read of the
+     * image plus a full detection on at most maxSide x maxSide pixels, whatever the size of the image.
+     *
+     * @param image The input image, 8-bit single channel.
+     * @param edges Output edge map of the reduced image, 255 for edges and 0 elsewhere.
+     * @param maxSide Longest side of the reduced image. Images already fitting in it are processed as they are.
+     */
+    void previewEdgeDetection(const cv::Mat& image, cv::Mat& edges, int maxSide = PREVIEW_MAX_SIDE);
+
+    /**
+     * @brief Applies Canny edge detection to an image file.
      * @param inputImage The input image file.
-     * @param outputImage The output image file.
+     * @param outputImage The output directory, where canny.png is written.
      */
     void cannyEdgeDetection(const std::string& inputImage, const std::string& outputImage);
 
+    /**
+     * @brief Enables saving the intermediate images of every stage, for debugging.
+     *
+     * Each stage writes its result (gauss.png, sobelDirection.png, sobelMagnitude.png, maxsupress.png and canny.png)
+     * to the directory. The fused pipeline has no blur or Sobel images to save.
+     *
+     * @param outputDirectory Directory prefix for the images, an empty string disables them (the default).
+     */
+    void setDebugOutput(const std::string& outputDirectory);
+
+    /**
+     * @brief Selects how the pipeline stages are scheduled.
+     * @param mode The pipeline mode, PipelineMode::Fused by default.
+     */
+    void setPipelineMode(PipelineMode mode);
+
+    /**
+     * @brief Selects the arithmetic of the blur.
+     * @param precision The blur arithmetic, Precision::Float by default.
+     */
+    void setPrecision(Precision precision);
+
+    /**
+     * @brief Selects the norm of the gradient magnitude.
+     *
+     * The thresholds compare with the magnitude in the chosen norm, L1 magnitudes are up to sqrt(2) larger than the
+     * L2 ones along the diagonals.
+     *
+     * @param norm The gradient norm, SobelKernels::GradientNorm::L2 by default.
+     */
+    void setGradientNorm(SobelKernels::GradientNorm norm);
+
+    /**
+     * @brief Selects the Sobel implementation, every level gives the same result.
+     * @param level The instruction set level, the best one of the running CPU by default. Levels the CPU doesn't
+     * support fall back to the best supported one.
+     */
+    void setSimdLevel(SobelKernels::SimdLevel level);
+
+    /**
+     * @brief Selects where the threads of every run are pinned, see NumaPlacement.
+     *
+     * With an affinity the strips are split in one block per thread instead of being handed out on demand, so the
+     * rows of a pooled buffer are worked on by the same thread, on the same node, from a run to the next. Runs from
+     * inside a parallel region, such as the small images of BatchEdgeDetection, keep the placement of their team.
+     * The calling thread is given its own CPUs back when the run returns.
+     *
+     * @param affinity The thread affinity, ThreadAffinity::None by default.
+     */
+    void setThreadAffinity(ThreadAffinity affinity);
+
+    /**
+     * @brief Selects a cache of non-maximum suppression outputs, so re-thresholding an image already seen only runs
+     * the hysteresis.
+     *
+     * Every single band run then hashes the image and looks its suppressed map up, along with the sigma, kernel size,
+     * precision and gradient norm. A hit skips blur, Sobel and suppression, a miss stores the map once suppressed.
+     * The edges are the same with or without the cache.
+     *
+     * @param cache The cache, usually SuppressionCache::instance(). nullptr disables it (the default).
+     */
+    void setSuppressionCache(SuppressionCache* cache);
+
+    /**
+     * @brief Selects where the hysteresis thresholds come from.
+     *
+     * The automatic modes add a histogram of the non-maximum suppression output, a single parallel pass over 8-bit
+     * pixels, to every run. The thresholds given to the constructor are then ignored.
+     *
+     * @param mode The threshold mode, ThresholdMode::Fixed by default.
+     */
+    void setThresholdMode(ThresholdMode mode);
+
+    /**
+     * @brief Gets the thresholds used by the last run.
+     * @return The thresholds, the ones given to the constructor before the first run.
+     */
+    AutoThreshold::Thresholds getThresholds() const;
+
+    /**
+     * @brief Gets the time taken by every stage of the last run, also printed as [TIMER] lines.
+     * @return The stage times.
+     */
+    const StageTimes& getStageTimes() const;
+
+    /**
+     * @brief Enables printing the time taken by every stage.
+     * @param enabled Whether the [TIMER] lines are printed, true by default.
+     */
+    void setTimers(bool enabled);
+
 private:
     float m_lowThreshold;
     float m_highThreshold;
     float m_sigma;
+    int m_kernelSize;
+    PipelineMode m_pipelineMode = PipelineMode::Fused;
+    ThresholdMode m_thresholdMode = ThresholdMode::Fixed;
+    AutoThreshold::Thresholds m_thresholds; ///< Thresholds of the last run.
+    StageTimes m_stageTimes;                ///< Stage times of the last run.
+    SobelKernels::SimdLevel m_simdLevel;
+    Precision m_precision = Precision::Float;
+    SobelKernels::GradientNorm m_gradientNorm = SobelKernels::GradientNorm::L2;
+    ThreadAffinity m_threadAffinity = ThreadAffinity::None;
+    SuppressionCache* m_suppressionCache = nullptr;
+    bool m_printTimers = true;
+    std::string m_debugOutput; ///< Directory for the intermediate images, empty when disabled.
     std::shared_ptr<ImageFileOperations> m_imageFileOperations;
-    cv::Mat m_magnitude;
-    cv::Mat m_direction;
-    cv::Mat m_cannyEdges;
+    cv::Mat m_magnitude; ///< Gradient magnitude, CV_16U fixed point (SobelKernels::MAGNITUDE_FRACTION_BITS).
+    cv::Mat m_direction; ///< Gradient direction sector codes (SobelKernels::DIRECTION_*), CV_8U.
+    cv::Mat m_cannyEdges; ///< Output of the running job, shares the caller's edges buffer.
     cv::Mat m_originalImage;
 
+    /**
+     * @brief Gets the normalized 1D gaussian kernel for a standard deviation.
+     *
+     * Kernels are computed once per sigma and size and cached for the lifetime of the process, so repeated runs don't
+     * pay for pow/exp again.
+     *
+     * @param sigma Standard deviation of the Gaussian kernel.
+     * @param kernelSize Number of weights of the kernel.
+     * @return The kernelSize weights of the kernel, summing to one.
+     */
+    static const std::vector<float>& getGaussianKernel(float sigma, int kernelSize);
+
+    /**
+     * @brief Gets the gaussian kernel in fixed point, with BLUR_FRACTION_BITS fraction bits, cached like the float one.
+     * @param sigma Standard deviation of the Gaussian kernel.
+     * @param kernelSize Number of weights of the kernel.
+     * @return The kernelSize weights of the kernel, summing to exactly 1 << BLUR_FRACTION_BITS.
+     */
+    static const std::vector<uint16_t>& getFixedPointKernel(float sigma, int kernelSize);
+
+    /**
+     * @brief Saves an intermediate image when the debug output is enabled.
+     * @param name File name of the image inside the debug output directory.
+     * @param image The image to save.
+     */
+    void saveDebugImage(const std::string& name, const cv::Mat& image);
+
     /**
      * @brief Applies Gaussian blur to an image.
      *
+     * @details The 2D gaussian is separable, so the blur runs as a horizontal and a vertical pass of the 1D kernel
+     * in single precision. Pixels outside the image count as zero.
      */
-    void applyGaussianBlur(const std::string& outputImage);
+    void applyGaussianBlur();
 
     /**
      * @brief Calculates gradient magnitudes and directions using Sobel operators.
      *
      * @details This function applies Sobel operators to the input image to compute
-     * the gradient magnitudes and directions. It convolves the image with
-     * Sobel kernels for both x and y directions and then computes the
-     * magnitude and direction of the gradients.
+     * the gradient magnitudes and directions. Each row is handled by the best
+     * SobelKernels implementation for the running CPU, which computes the
+     * magnitude and the quantized direction sector in a single pass.
      */
-    void sobelOperator(const std::string& outputImage);
+    void sobelOperator();
+
+    /**
+     * @brief Runs blur, Sobel and non-maximum suppression as a single fused pass.
+     *
+     * @details The image is split in strips of rows processed in parallel. Each thread streams its strip, plus the
+     * halo rows the kernels need, through small rolling row buffers, and only writes the suppressed edges to
+     * m_cannyEdges. The result is identical to running the three stages separately.
+     */
+    void fusedBlurSobelSuppression();
+
+    /**
+     * @brief Fused blur, Sobel and non-maximum suppression over several bands.
+     *
+     * @details Like fusedBlurSobelSuppression(), with one gradient stream per band merged row by row before the
+     * suppression. Empty weights stand for the default ones of the combination.
+     */
+    void fusedMultiBandSuppression(const std::vector<cv::Mat>& bands,
+                                   BandCombination combination,
+                                   const std::vector<float>& weights);
 
     /**
      *
@@ -78,26 +370,28 @@ private:
      * gradient magnitude and direction.
      *
      */
-    void nonMaximumSuppression(const std::string& outputImage);
+    void nonMaximumSuppression();
+
+    /**
+     * @brief Gets the key of the suppressed map of an image with the settings of this detector.
+     * @param image The input image.
+     * @return The cache key.
+     */
+    SuppressionCache::Key suppressionKey(const cv::Mat& image) const;
+
+    /**
+     * @brief Sets m_thresholds for the running job, from m_cannyEdges after non-maximum suppression.
+     */
+    void selectThresholds();
 
     /**
      * @brief  Applies a double threshold and edge tracking by hysteresis to an edge map.
      * This function identifies strong edges and weak edges and attempts to
      * connect weak edges to strong edges to form continuous lines.
+     * The result is binary, 255 for edges and 0 elsewhere, and deterministic at any thread count.
      *
      */
-    void applyLinkingAndHysteresis(const std::string& outputImage);
-
-    /**
-     * @brief Checks the contours of the image.
-     * @param strongEdges The strong edges of the image.
-     * @param weakEdges The weak edges of the image.
-     * @param row The row of the pixel.
-     * @param col The column of the pixel.
-     * @param prevRow The previous row of the pixel.
-     * @param prevCol The previous column of the pixel.
-     */
-    void checkContours(cv::Mat& strongEdges, const cv::Mat& weakEdges, int row, int col, int prevRow, int prevCol);
+    void applyLinkingAndHysteresis();
 };
 
 #endif /* _CANNY_EDGE_FILTER_HPP */
@@ -0,0 +1,103 @@
+/*
+ * LuckyAlgorithmForSatellites - edgeMapCodec
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _EDGE_MAP_CODEC_HPP
+#define _EDGE_MAP_CODEC_HPP
+
+#include <opencv2/core/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Compact format for binary edge maps.
+ *
+ * An edge map only carries one bit per pixel, and after non-maximum suppression almost all of them are zero. The
+ * format packs the pixels 8 per byte, most significant bit first, every row padded to a whole byte like a PBM (P4)
+ * body, and then replaces the runs of zero bytes by their length. A decoder only needs a few lines of C, so clients
+ * can decode it directly instead of going through PNG and gzip.
+ *
+ * Layout, little endian:
+ *
+ * | Offset | Size | Field                                              |
+ * |--------|------|----------------------------------------------------|
+ * | 0      | 4    | Magic "EDGM"                                       |
+ * | 4      | 1    | Version, VERSION                                   |
+ * | 5      | 1    | Encoding, ENCODING_PACKED or ENCODING_ZERO_RUNS    |
+ * | 6      | 2    | Reserved, 0                                        |
+ * | 8      | 4    | Columns                                            |
+ * | 12     | 4    | Rows                                               |
+ * | 16     | 8    | Payload bytes                                      |
+ * | 24     |      | Payload                                            |
+ *
+ * A zero runs payload is a sequence of tokens, each a LEB128 varint v followed by v >> 1 bytes copied as they are
+ * when v is odd, or standing for v >> 1 zero bytes when v is even. Expanded, it is the packed bitmap. Edge maps
+ * dense enough for the tokens not to pay off are stored packed, the payload being the bitmap itself.
+ */
+namespace EdgeMapCodec
+{
+/**
+ * @brief Version written in the header.
+ */
+constexpr uint8_t VERSION = 1;
+
+/**
+ * @brief Size of the header.
+ */
+constexpr size_t HEADER_BYTES = 24;
+
+/**
+ * @brief Payload encoding codes.
+ */
+constexpr uint8_t ENCODING_PACKED = 0;    ///< The packed bitmap.
+constexpr uint8_t ENCODING_ZERO_RUNS = 1; ///< The packed bitmap with the runs of zero bytes replaced by tokens.
+
+/**
+ * @brief The fields of a header.
+ */
+struct Header
+{
+    uint8_t encoding;      ///< Payload encoding.
+    uint32_t cols;         ///< Columns of the edge map.
+    uint32_t rows;         ///< Rows of the edge map.
+    uint64_t payloadBytes; ///< Bytes after the header.
+};
+
+/**
+ * @brief Encodes an edge map, blocks of rows in parallel.
+ * @param edges 8-bit single channel edge map, any non zero pixel is an edge.
+ * @param buffer Output with the header and the payload, replaced.
+ */
+void encode(const cv::Mat& edges, std::vector<uint8_t>& buffer);
+
+/**
+ * @brief Reads and validates the header of an encoded edge map.
+ * @param data Encoded bytes, at least HEADER_BYTES.
+ * @param size Number of bytes available.
+ * @return The header fields.
+ */
+Header readHeader(const uint8_t* data, size_t size);
+
+/**
+ * @brief Decodes an edge map.
+ * @param data Encoded bytes, the header and the whole payload.
+ * @param size Number of bytes.
+ * @param edges Output edge map, 255 for edges and 0 elsewhere. Reused when it has the right size and type.
+ */
+void decode(const uint8_t* data, size_t size, cv::Mat& edges);
+} // namespace EdgeMapCodec
+
+#endif /* _EDGE_MAP_CODEC_HPP */
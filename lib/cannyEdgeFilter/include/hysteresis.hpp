@@ -0,0 +1,57 @@
+/*
+ * LuckyAlgorithmForSatellites - hysteresis
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _HYSTERESIS_HPP
+#define _HYSTERESIS_HPP
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief Edge tracking by hysteresis.
+ *
+ * A pixel is an edge when its value reaches the low threshold and it is 8-connected, through pixels that also reach
+ * the low threshold, to a pixel that reaches the high threshold. That only depends on the connected components of the
+ * thresholded image, so the result is the same for any traversal order and any number of threads.
+ */
+namespace Hysteresis
+{
+/**
+ * @brief Default number of rows of the strips the image is split in.
+ */
+constexpr int DEFAULT_STRIP_ROWS = 64;
+
+/**
+ * @brief Applies the double threshold and the edge tracking in parallel.
+ *
+ * The image is split in strips of rows that are flood filled independently from their strong pixels. Edges that
+ * cross a strip boundary are then propagated in rounds: every round seeds the weak pixels touching an edge pixel in
+ * the boundary rows of the neighboring strips, as they were at the end of the previous round, until no boundary row
+ * changes. Strips only write their own rows and only read a snapshot of the others, so there are no races.
+ *
+ * @param suppressed 8-bit single channel edge strengths, usually after non-maximum suppression.
+ * @param edges Output 8-bit edge map, 255 for edges and 0 elsewhere. It may be the same matrix as suppressed.
+ * @param lowThreshold Weak edge threshold.
+ * @param highThreshold Strong edge threshold.
+ * @param stripRows Rows of every strip, it does not change the result.
+ */
+void hysteresis(const cv::Mat& suppressed,
+                cv::Mat& edges,
+                float lowThreshold,
+                float highThreshold,
+                int stripRows = DEFAULT_STRIP_ROWS);
+} // namespace Hysteresis
+
+#endif /* _HYSTERESIS_HPP */
@@ -17,8 +17,11 @@
 #ifndef _IMAGE_FILE_OPERATIONS_HPP
 #define _IMAGE_FILE_OPERATIONS_HPP
 
+#include "mappedImage.hpp"
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <string>
+#include <vector>
 
 /**
  * @brief The ImageFileOperations class provides methods to save and load images.
@@ -39,6 +42,35 @@ public:
      * @return The loaded image.
      */
     cv::Mat loadImage(const std::string& filename);
+
+    /**
+     * @brief Loads an image, mapping it instead of decoding it when it is an 8-bit binary PGM or a raw image.
+     * @param filename The name of the file to load the image from.
+     * @param mapped Holds the mapping of a mapped image, the returned image is only valid while it does.
+     * @param access Whether such an image is mapped or read, see MappedImage. Files that may be overwritten while
+     * the image is in use must be read.
+     * @return The loaded image, read only when mapped. Other formats are decoded like loadImage() does.
+     */
+    cv::Mat openImage(const std::string& filename, MappedImage& mapped,
+                      MappedImage::Access access = MappedImage::Access::Map);
+
+    /**
+     * @brief Saves an 8-bit single channel image in the raw format of MappedImage.
+     * @param filename The name of the file to save the image to.
+     * @param image The image to save.
+     * @param alignment Bytes the pixel offset and the row stride are rounded up to, 1 packs the rows.
+     * @return True if the image was saved, false otherwise.
+     */
+    bool saveRawImage(const std::string& filename, const cv::Mat& image, size_t alignment = 64);
+
+    /**
+     * @brief Encodes an image in memory, without touching the filesystem.
+     * @param image The image to encode.
+     * @param buffer Output buffer with the encoded image.
+     * @param extension File extension that selects the format, ".png" by default.
+     * @return True if the image was encoded, false otherwise.
+     */
+    bool encodeImage(const cv::Mat& image, std::vector<uchar>& buffer, const std::string& extension = ".png");
 };
 
 #endif /* _IMAGE_FILE_OPERATIONS_HPP */
@@ -0,0 +1,113 @@
+/*
+ * LuckyAlgorithmForSatellites - mappedImage
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _MAPPED_IMAGE_HPP
+#define _MAPPED_IMAGE_HPP
+
+#include "workspacePool.hpp"
+#include <opencv2/core/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief An uncompressed image file mapped in memory and wrapped in a cv::Mat, without decoding or copying it.
+ *
+ * Two formats are mapped:
+ * - Binary PGM (P5) with a maximum value up to 255.
+ * - Raw images: a 20-byte little endian header with the magic "RAW8", the columns, the rows, the offset of the
+ *   pixels from the start of the file and the bytes between the starts of two rows, followed by 8-bit pixels.
+ *   The offset and the row stride let producers align the pixels, see ImageFileOperations::saveRawImage().
+ *
+ * Pages are read on demand as the pipeline first touches them, the kernel is asked to start reading ahead right away,
+ * so the whole ingest cost is a few system calls and the first parallel pass overlaps with the disk.
+ *
+ * A mapping is only safe while nobody rewrites the file: once it is truncated under the mapping, the next access to
+ * a page past its new end raises SIGBUS. Files that may be overwritten in place while in use are read instead, with
+ * pread into a buffer of WorkspacePool::instance(), where a file shrinking mid-read is only a failed read.
+ */
+class MappedImage
+{
+public:
+    /**
+     * @brief Magic of the raw format.
+     */
+    static constexpr char RAW_MAGIC[4] = {'R', 'A', 'W', '8'};
+
+    /**
+     * @brief Size of the header of the raw format.
+     */
+    static constexpr size_t RAW_HEADER_BYTES = 20;
+
+    /**
+     * @brief Bytes of the start of a file the header is looked for in when the file is read, PGM comments included.
+     */
+    static constexpr size_t READ_HEADER_BYTES = 4096;
+
+    /**
+     * @brief How the pixels get into memory.
+     */
+    enum class Access
+    {
+        Map, ///< Mapped, for files nobody overwrites while they are in use.
+        Read ///< Read into a pooled buffer, for files that may be overwritten in place.
+    };
+
+    MappedImage() = default;
+
+    /**
+     * @brief Maps or reads an image file.
+     * @param filename The path of a binary 8-bit PGM or raw image.
+     * @param access Whether the file is mapped or read.
+     * @throws std::runtime_error if the file can not be mapped or read, or is not in one of the formats.
+     */
+    explicit MappedImage(const std::string& filename, Access access = Access::Map);
+
+    MappedImage(MappedImage&& other) noexcept;
+    MappedImage& operator=(MappedImage&& other) noexcept;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+    ~MappedImage();
+
+    /**
+     * @brief Checks the first bytes of a file for one of the mapped formats.
+     * @param filename The path of the file.
+     * @return Whether the file starts like a binary PGM or a raw image. The header may still be invalid.
+     */
+    static bool isMappable(const std::string& filename);
+
+    /**
+     * @brief Gets the mapped image.
+     *
+     * The pixels are read only. Copies of mat() share the mapping or the buffer, so none may outlive the MappedImage.
+     *
+     * @return The image, 8-bit single channel, empty for a default constructed MappedImage.
+     */
+    const cv::Mat& mat() const
+    {
+        return m_mat;
+    }
+
+private:
+    void unmap();
+
+    void* m_mapping = nullptr;
+    size_t m_size = 0;
+    WorkspacePool::Lease m_buffer;
+    cv::Mat m_mat;
+};
+
+#endif /* _MAPPED_IMAGE_HPP */
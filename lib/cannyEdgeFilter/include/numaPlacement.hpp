@@ -0,0 +1,82 @@
+/*
+ * LuckyAlgorithmForSatellites - numaPlacement
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _NUMA_PLACEMENT_HPP
+#define _NUMA_PLACEMENT_HPP
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+/**
+ * @brief Where the OpenMP threads of the pipeline run.
+ */
+enum class ThreadAffinity
+{
+    None, ///< Threads are left where the OS or the OpenMP environment puts them, strips are scheduled dynamically.
+    Node, ///< Every thread is pinned to the CPUs of one NUMA node, strips are split in one block per thread.
+    Core  ///< Every thread is pinned to a single CPU, strips are split in one block per thread.
+};
+
+/**
+ * @brief Placement of threads and memory on the NUMA nodes of the host.
+ *
+ * Linux places a page on the node of the thread that first writes it. When the rows of an image are split in one
+ * contiguous block per thread, and the thread count and block of every thread stay the same from a run to the next,
+ * the rows every thread works on stay in the memory of its node. Threads are spread over the nodes in order, so
+ * every node owns a contiguous range of rows.
+ *
+ * The topology is read from sysfs, without libnuma. Hosts without it are seen as a single node.
+ */
+namespace NumaPlacement
+{
+/**
+ * @brief A NUMA node and the CPUs of it the process may run on.
+ */
+struct Node
+{
+    int id;                ///< Node number of the kernel.
+    std::vector<int> cpus; ///< CPUs of the node, in increasing order.
+};
+
+/**
+ * @brief Gets the NUMA nodes of the host, read once per process.
+ * @return The nodes with at least one CPU available to the process, never empty.
+ */
+const std::vector<Node>& topology();
+
+/**
+ * @brief Pins every thread of the OpenMP team to the CPUs of the affinity.
+ *
+ * Thread i of n goes to node i * nodes / n, or to the i-th CPU counting node by node for Core. The OpenMP runtime
+ * keeps its threads from a parallel region to the next, so the pinning holds for the following regions of the same
+ * size. ThreadAffinity::None gives every thread back all the CPUs of the process.
+ *
+ * @param affinity The placement of the threads.
+ * @param threads Threads of the team, 0 for the OpenMP default.
+ */
+void pinThreads(ThreadAffinity affinity, int threads = 0);
+
+/**
+ * @brief Writes a freshly allocated buffer with the same static row split as the parallel loops over it.
+ *
+ * Every page ends up on the node of the thread that will work on its rows. The contents are zeroed.
+ *
+ * @param mat The buffer, continuous or not.
+ */
+void firstTouch(cv::Mat& mat);
+} // namespace NumaPlacement
+
+#endif /* _NUMA_PLACEMENT_HPP */
@@ -17,10 +17,13 @@
 #ifndef _SATELLITE_IMAGE_WRAPPER_HPP
 #define _SATELLITE_IMAGE_WRAPPER_HPP
 
+#include "cannyEdgeFilter.hpp"
 #include <gdal_priv.h>
 #include <iostream>
 #include <opencv2/core/core.hpp>
 #include <string>
+#include <utility>
+#include <vector>
 
 /**
  * @brief The SatelliteImageWrapper class provides methods to read satellite images.
@@ -39,12 +42,91 @@ public:
      */
     ~SatelliteImageWrapper();
 
+    /**
+     * @brief Default side of the square tiles used by detectEdgesTiled(), a multiple of 16 as GeoTIFF tiles require.
+     */
+    static constexpr int DEFAULT_TILE_SIZE = 1024;
+
+    /**
+     * @brief Pixels read around every tile by detectEdgesTiled().
+     *
+     * Blur, Sobel and non-maximum suppression need at most 5 of them, with a 7 pixels blur kernel, to give the same
+     * result as the whole image. The rest lets hysteresis follow weak edges that leave the tile and come back.
+     */
+    static constexpr int TILE_HALO = 32;
+
     /**
      * @brief Read a band from the image
      * @param bandNumber Band number to read
      */
     cv::Mat readBand(int bandNumber);
 
+    /**
+     * @brief Read a window of a band, scaled to 8-bit like readBand().
+     * @param bandNumber Band number to read
+     * @param window Pixel window to read, it must be inside the band
+     * @return The 8-bit window
+     */
+    cv::Mat readWindow(int bandNumber, const cv::Rect& window);
+
+    /**
+     * @brief Read several bands concurrently, each scaled to 8-bit like readBand().
+     * @param bandNumbers Band numbers to read
+     * @return The 8-bit bands, in the same order
+     */
+    std::vector<cv::Mat> readBands(const std::vector<int>& bandNumbers);
+
+    /**
+     * @brief Runs Canny edge detection over a band tile by tile, writing the edges to a tiled GeoTIFF.
+     *
+     * Tiles are read with a TILE_HALO pixels border, processed in parallel and written as blocks of the output, so
+     * the memory used is proportional to the tile size and the number of threads rather than to the scene size.
+     * Every thread reads through its own dataset handle, and the writes are serialized. The output keeps the
+     * georeferencing of the input.
+     *
+     * @param bandNumber Band number to process
+     * @param outputFile GeoTIFF file to create
+     * @param lowThreshold The lower threshold value for edge detection
+     * @param highThreshold The higher threshold value for edge detection
+     * @param sigma Standard deviation of the Gaussian kernel
+     * @param tileSize Side of the square tiles, a multiple of 16
+     * @param kernelSize Side of the Gaussian kernel, 3, 5 or 7
+     */
+    void detectEdgesTiled(int bandNumber,
+                          const std::string& outputFile,
+                          float lowThreshold,
+                          float highThreshold,
+                          float sigma,
+                          int tileSize = DEFAULT_TILE_SIZE,
+                          int kernelSize = KERNEL_SIZE);
+
+    /**
+     * @brief Runs multi-band Canny edge detection tile by tile, writing the edges to a tiled GeoTIFF.
+     *
+     * Like the single band version, every tile reads all the bands and merges their gradients before non-maximum
+     * suppression, see EdgeDetection::cannyEdgeDetection(const std::vector<cv::Mat>&, cv::Mat&, BandCombination,
+     * std::vector<float>).
+     *
+     * @param bandNumbers Band numbers to process
+     * @param outputFile GeoTIFF file to create
+     * @param lowThreshold The lower threshold value for edge detection
+     * @param highThreshold The higher threshold value for edge detection
+     * @param sigma Standard deviation of the Gaussian kernel
+     * @param combination How the band gradients are merged
+     * @param weights One weight per band, empty for the default ones
+     * @param tileSize Side of the square tiles, a multiple of 16
+     * @param kernelSize Side of the Gaussian kernel, 3, 5 or 7
+     */
+    void detectEdgesTiled(const std::vector<int>& bandNumbers,
+                          const std::string& outputFile,
+                          float lowThreshold,
+                          float highThreshold,
+                          float sigma,
+                          BandCombination combination,
+                          const std::vector<float>& weights = {},
+                          int tileSize = DEFAULT_TILE_SIZE,
+                          int kernelSize = KERNEL_SIZE);
+
     /**
      * @brief Check if the image is valid
      * @return true if the image is valid, false otherwise
@@ -52,7 +134,24 @@ public:
     bool isValid() const;
 
 private:
+    std::string m_filename;
     GDALDataset* m_dataset;
+
+    /**
+     * @brief Gets the minimum and maximum values of a band, computing them when the file doesn't have them
+     * @param band The band
+     * @return The minimum and the maximum
+     */
+    static std::pair<double, double> bandRange(GDALRasterBand* band);
+
+    /**
+     * @brief Reads a window of a band and scales it to 8-bit
+     * @param band The band
+     * @param window Pixel window to read
+     * @param range Minimum and maximum of the band, mapped to 0 and 255
+     * @return The 8-bit window
+     */
+    static cv::Mat readScaled(GDALRasterBand* band, const cv::Rect& window, const std::pair<double, double>& range);
 };
 
 #endif /* _SATELLITE_IMAGE_WRAPPER_HPP */
@@ -0,0 +1,115 @@
+/*
+ * LuckyAlgorithmForSatellites - sobelKernels
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _SOBEL_KERNELS_HPP
+#define _SOBEL_KERNELS_HPP
+
+#include <cstdint>
+
+/**
+ * @brief Row kernels computing the Sobel gradient of an 8-bit image.
+ *
+ * Every implementation produces, in a single pass, the gradient magnitude as unsigned fixed point with
+ * MAGNITUDE_FRACTION_BITS fraction bits (truncated), in the L2 or the L1 norm, and the gradient direction quantized
+ * to one of the four sectors used by non-maximum suppression. The direction is computed with integer comparisons
+ * against tan(22.5) and tan(67.5), so no atan2 is involved. All the implementations give bit-identical results.
+ */
+namespace SobelKernels
+{
+/**
+ * @brief Direction sector codes, named after the gradient angle they cover.
+ */
+constexpr uint8_t DIRECTION_0 = 0;   ///< [0, 22.5) and [157.5, 180): compare left and right neighbors.
+constexpr uint8_t DIRECTION_45 = 1;  ///< [22.5, 67.5): compare lower-left and upper-right neighbors.
+constexpr uint8_t DIRECTION_90 = 2;  ///< [67.5, 112.5): compare upper and lower neighbors.
+constexpr uint8_t DIRECTION_135 = 3; ///< [112.5, 157.5): compare upper-left and lower-right neighbors.
+
+/**
+ * @brief Fraction bits of the fixed point magnitudes.
+ *
+ * The largest 8-bit Sobel magnitude is 1020 * sqrt(2), or 2040 in the L1 norm, so 11 integer bits and 5 fraction
+ * bits fit in uint16.
+ */
+constexpr int MAGNITUDE_FRACTION_BITS = 5;
+
+/**
+ * @brief Norm of the gradient magnitude.
+ */
+enum class GradientNorm
+{
+    L2, /**< sqrt(gx^2 + gy^2), the textbook magnitude. */
+    L1  /**< |gx| + |gy|, integer only and up to sqrt(2) larger along the diagonals, like OpenCV's default. */
+};
+
+/**
+ * @brief Instruction set levels with a Sobel implementation.
+ */
+enum class SimdLevel
+{
+    Scalar, /**< Portable C++ implementation. */
+    SSE4,   /**< SSE4.1, 4 pixels per iteration. */
+    AVX2,   /**< AVX2, 8 pixels per iteration. */
+    AVX512  /**< AVX-512F, 16 pixels per iteration. */
+};
+
+/**
+ * @brief Signature of a Sobel row kernel.
+ *
+ * Computes columns [1, cols - 1) of one output row from the three input rows centered on it. Columns 0 and
+ * cols - 1 are left untouched.
+ *
+ * @param above Input row above the output row.
+ * @param center Input row at the output row.
+ * @param below Input row below the output row.
+ * @param magnitude Output gradient magnitudes, fixed point with MAGNITUDE_FRACTION_BITS fraction bits.
+ * @param direction Output direction sector codes.
+ * @param cols Number of columns of the rows.
+ */
+using SobelRowFn = void (*)(const uint8_t* above, const uint8_t* center, const uint8_t* below, uint16_t* magnitude,
+                            uint8_t* direction, int cols);
+
+/**
+ * @brief Detects the best instruction set level supported by the running CPU.
+ * @return The highest supported SimdLevel, detected once and cached.
+ */
+SimdLevel detectSimdLevel();
+
+/**
+ * @brief Gets a printable name for an instruction set level.
+ * @param level The instruction set level.
+ * @return The name of the level.
+ */
+const char* simdLevelName(SimdLevel level);
+
+/**
+ * @brief Gets the Sobel row kernel for an instruction set level.
+ *
+ * Levels above the one supported by the running CPU fall back to the best supported one.
+ *
+ * @param level The requested instruction set level.
+ * @param norm The norm of the magnitudes.
+ * @return The row kernel.
+ */
+SobelRowFn getSobelRow(SimdLevel level, GradientNorm norm = GradientNorm::L2);
+
+/**
+ * @brief Gets the Sobel row kernel for the best level supported by the running CPU.
+ * @return The row kernel.
+ */
+SobelRowFn getSobelRow();
+} // namespace SobelKernels
+
+#endif /* _SOBEL_KERNELS_HPP */
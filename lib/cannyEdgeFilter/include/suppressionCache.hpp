@@ -0,0 +1,125 @@
+/*
+ * LuckyAlgorithmForSatellites - suppressionCache
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _SUPPRESSION_CACHE_HPP
+#define _SUPPRESSION_CACHE_HPP
+
+#include <opencv2/core/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+/**
+ * @brief Thread safe LRU cache of non-maximum suppression outputs.
+ *
+ * Blur, Sobel and non-maximum suppression only depend on the image and the blur and gradient settings, not on the
+ * thresholds. Re-tuning the thresholds of an image already seen only needs the hysteresis, a small fraction of the
+ * pipeline, once its suppressed map is cached. Images are identified by a hash of their pixels, so reloading the same
+ * file still hits.
+ */
+class SuppressionCache
+{
+public:
+    /**
+     * @brief Default limit of the bytes of the cached maps.
+     */
+    static constexpr size_t DEFAULT_CAPACITY = 256 * 1024 * 1024;
+
+    /**
+     * @brief Everything the suppressed map depends on.
+     */
+    struct Key
+    {
+        uint64_t imageHash = 0; ///< hashImage() of the input image.
+        int rows = 0;           ///< Rows of the input image.
+        int cols = 0;           ///< Columns of the input image.
+        float sigma = 0;        ///< Standard deviation of the blur.
+        int kernelSize = 0;     ///< Side of the blur kernel.
+        uint32_t options = 0;   ///< Other settings changing the map, such as the blur precision, set by the caller.
+
+        bool operator==(const Key& other) const;
+    };
+
+    /**
+     * @brief Constructor for the SuppressionCache class.
+     * @param capacity Bytes of maps kept at most, the least recently used ones are dropped beyond it.
+     */
+    explicit SuppressionCache(size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Gets the cache shared by the whole process.
+     * @return The process wide cache.
+     */
+    static SuppressionCache& instance();
+
+    /**
+     * @brief Hashes the pixels of an image, rows in parallel.
+     * @param image 8-bit single channel image, continuous or not.
+     * @return 64-bit hash of the pixels, independent of the row stride and the thread count.
+     */
+    static uint64_t hashImage(const cv::Mat& image);
+
+    /**
+     * @brief Copies a cached map out, marking it as the most recently used.
+     * @param key The key the map was stored with.
+     * @param suppressed Output copy of the map, reused when it has the right size and type.
+     * @return Whether the map was cached, suppressed is untouched otherwise.
+     */
+    bool find(const Key& key, cv::Mat& suppressed);
+
+    /**
+     * @brief Stores a copy of a map, replacing any map of the same key.
+     *
+     * Maps larger than the whole capacity are not stored.
+     *
+     * @param key The key of the map.
+     * @param suppressed 8-bit non-maximum suppression output.
+     */
+    void insert(const Key& key, const cv::Mat& suppressed);
+
+    /**
+     * @brief Gets the number of successful find() calls.
+     * @return The hit count since the cache was created.
+     */
+    size_t hits() const;
+
+    /**
+     * @brief Gets the bytes of the cached maps.
+     * @return The cached bytes.
+     */
+    size_t cachedBytes() const;
+
+    /**
+     * @brief Drops every cached map.
+     */
+    void clear();
+
+private:
+    struct Entry
+    {
+        Key key;
+        cv::Mat suppressed;
+    };
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries; ///< Most recently used first.
+    size_t m_capacity;
+    size_t m_cachedBytes = 0;
+    size_t m_hits = 0;
+};
+
+#endif /* _SUPPRESSION_CACHE_HPP */
@@ -0,0 +1,129 @@
+/*
+ * LuckyAlgorithmForSatellites - workspacePool
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _WORKSPACE_POOL_HPP
+#define _WORKSPACE_POOL_HPP
+
+#include <opencv2/core/core.hpp>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+/**
+ * @brief Thread safe pool of working images, keyed by their dimensions and type.
+ *
+ * Every Canny run needs the same handful of large buffers. Leasing them from a pool that outlives the runs avoids
+ * paying for the allocation and the page faults of every buffer on every job. The per thread scratch rows of the
+ * stages are leased too, so once the pool is warm a job of an already seen size allocates nothing.
+ */
+class WorkspacePool
+{
+public:
+    /**
+     * @brief Default limit of the bytes kept by a pool while nobody uses them.
+     */
+    static constexpr size_t DEFAULT_CAPACITY = 512 * 1024 * 1024;
+
+    /**
+     * @brief A buffer borrowed from the pool, given back when the lease is destroyed.
+     *
+     * Copies of mat() share its data, so none may outlive the lease.
+     */
+    class Lease
+    {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        /**
+         * @brief Gets the leased buffer.
+         * @return The buffer, with the dimensions and type it was acquired with.
+         */
+        cv::Mat& mat()
+        {
+            return m_mat;
+        }
+
+    private:
+        friend class WorkspacePool;
+
+        Lease(WorkspacePool* pool, cv::Mat mat);
+
+        WorkspacePool* m_pool = nullptr;
+        cv::Mat m_mat;
+    };
+
+    /**
+     * @brief Constructor for the WorkspacePool class.
+     * @param capacity Bytes the pool keeps cached at most, buffers released beyond it are freed.
+     */
+    explicit WorkspacePool(size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Gets the pool shared by the whole process.
+     * @return The process wide pool.
+     */
+    static WorkspacePool& instance();
+
+    /**
+     * @brief Borrows a buffer, reusing a cached one of the same dimensions and type when there is one.
+     *
+     * New buffers are first touched by the threads that will work on their rows, see NumaPlacement::firstTouch().
+     *
+     * @param rows Rows of the buffer.
+     * @param cols Columns of the buffer.
+     * @param type OpenCV type of the buffer.
+     * @return The lease of the buffer, its contents are undefined.
+     */
+    Lease acquire(int rows, int cols, int type);
+
+    /**
+     * @brief Gets the number of buffers the pool had to allocate since it was created.
+     * @return The allocation count, it doesn't grow while jobs only reuse cached buffers.
+     */
+    size_t allocations() const;
+
+    /**
+     * @brief Gets the bytes of the buffers currently cached and not leased.
+     * @return The cached bytes.
+     */
+    size_t cachedBytes() const;
+
+    /**
+     * @brief Frees every cached buffer. Leased buffers are not affected.
+     */
+    void clear();
+
+private:
+    using Key = std::tuple<int, int, int>;
+
+    void release(cv::Mat& mat);
+
+    mutable std::mutex m_mutex;
+    std::map<Key, std::vector<cv::Mat>> m_free;
+    size_t m_capacity;
+    size_t m_cachedBytes = 0;
+    std::atomic<size_t> m_allocations {0};
+};
+
+#endif /* _WORKSPACE_POOL_HPP */
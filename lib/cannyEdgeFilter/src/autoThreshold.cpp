@@ -0,0 +1,162 @@
+/*
+ * LuckyAlgorithmForSatellites - autoThreshold
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "autoThreshold.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace AutoThreshold
+{
+namespace
+{
+Thresholds fromHigh(int high, float lowRatio)
+{
+    return {std::max(1.0f, high * lowRatio), static_cast<float>(high)};
+}
+} // namespace
+
+Histogram histogram(const cv::Mat& image, int rowStep)
+{
+    if (image.type() != CV_8U)
+    {
+        throw std::runtime_error("The histogram expects an 8-bit single channel image");
+    }
+    if (rowStep < 1)
+    {
+        throw std::runtime_error("The histogram row step must be positive");
+    }
+    const int sampledRows = (image.rows + rowStep - 1) / rowStep;
+
+    Histogram total {};
+    #pragma omp parallel
+    {
+        // Four interleaved histograms, so runs of the same value don't wait on the store of the previous increment
+        std::array<Histogram, 4> local {};
+
+        #pragma omp for nowait
+        for (int sample = 0; sample < sampledRows; ++sample)
+        {
+            const uint8_t* src = image.ptr<uint8_t>(sample * rowStep);
+            int col = 0;
+            for (; col + 8 <= image.cols; col += 8)
+            {
+                // After non-maximum suppression most words of 8 pixels are all zeros, and zeros aren't counted here
+                uint64_t word;
+                std::memcpy(&word, src + col, sizeof(word));
+                if (word == 0)
+                {
+                    continue;
+                }
+                for (int i = 0; i < 8; i += 4)
+                {
+                    ++local[0][src[col + i]];
+                    ++local[1][src[col + i + 1]];
+                    ++local[2][src[col + i + 2]];
+                    ++local[3][src[col + i + 3]];
+                }
+            }
+            for (; col < image.cols; ++col)
+            {
+                ++local[0][src[col]];
+            }
+        }
+
+        #pragma omp critical
+        for (size_t value = 1; value < total.size(); ++value)
+        {
+            total[value] += local[0][value] + local[1][value] + local[2][value] + local[3][value];
+        }
+    }
+
+    uint64_t nonZero = 0;
+    for (size_t value = 1; value < total.size(); ++value)
+    {
+        nonZero += total[value];
+    }
+    total[0] = static_cast<uint64_t>(sampledRows) * image.cols - nonZero;
+    return total;
+}
+
+Thresholds otsu(const Histogram& histogram, float lowRatio)
+{
+    uint64_t count = 0;
+    double sum = 0;
+    for (size_t value = 1; value < histogram.size(); ++value)
+    {
+        count += histogram[value];
+        sum += static_cast<double>(value) * histogram[value];
+    }
+    if (count == 0)
+    {
+        return fromHigh(255, lowRatio);
+    }
+
+    // Splits the values in [1, high) and [high, 255], maximizing the variance between both classes
+    int best = 1;
+    double bestVariance = -1;
+    uint64_t lowCount = 0;
+    double lowSum = 0;
+    for (int high = 2; high < static_cast<int>(histogram.size()); ++high)
+    {
+        lowCount += histogram[high - 1];
+        lowSum += static_cast<double>(high - 1) * histogram[high - 1];
+        const uint64_t highCount = count - lowCount;
+        if (lowCount == 0 || highCount == 0)
+        {
+            continue;
+        }
+
+        const double difference = lowSum / lowCount - (sum - lowSum) / highCount;
+        const double variance = static_cast<double>(lowCount) * highCount * difference * difference;
+        if (variance > bestVariance)
+        {
+            bestVariance = variance;
+            best = high;
+        }
+    }
+    return fromHigh(best, lowRatio);
+}
+
+Thresholds percentile(const Histogram& histogram, float highPercentile, float lowRatio)
+{
+    if (highPercentile < 0 || highPercentile > 1)
+    {
+        throw std::runtime_error("The high percentile must be in [0, 1]");
+    }
+
+    uint64_t count = 0;
+    for (size_t value = 1; value < histogram.size(); ++value)
+    {
+        count += histogram[value];
+    }
+    if (count == 0)
+    {
+        return fromHigh(255, lowRatio);
+    }
+
+    // The first value whose pixels would take the ones below it past the percentile
+    const double below = highPercentile * count;
+    uint64_t cumulative = 0;
+    int high = 1;
+    while (high < 255 && cumulative + histogram[high] <= below)
+    {
+        cumulative += histogram[high];
+        ++high;
+    }
+    return fromHigh(high, lowRatio);
+}
+} // namespace AutoThreshold
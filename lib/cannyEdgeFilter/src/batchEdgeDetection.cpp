@@ -0,0 +1,145 @@
+/*
+ * LuckyAlgorithmForSatellites - batchEdgeDetection
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "batchEdgeDetection.hpp"
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <omp.h>
+
+double BatchReport::imagesPerSecond() const
+{
+    return seconds > 0 ? images / seconds : 0;
+}
+
+double BatchReport::megapixelsPerSecond() const
+{
+    return seconds > 0 ? pixels / seconds / 1e6 : 0;
+}
+
+BatchEdgeDetection::BatchEdgeDetection(float lowThreshold, float highThreshold, float sigma, int kernelSize)
+    : m_lowThreshold(lowThreshold)
+    , m_highThreshold(highThreshold)
+    , m_sigma(sigma)
+    , m_kernelSize(kernelSize)
+{
+    // Fail now rather than in every task
+    makeDetector();
+}
+
+void BatchEdgeDetection::setSmallImagePixels(size_t pixels)
+{
+    m_smallImagePixels = pixels;
+}
+
+void BatchEdgeDetection::setThreads(int threads)
+{
+    m_threads = threads;
+}
+
+void BatchEdgeDetection::setTimers(bool enabled)
+{
+    m_printTimers = enabled;
+}
+
+EdgeDetection BatchEdgeDetection::makeDetector() const
+{
+    EdgeDetection detector(m_lowThreshold, m_highThreshold, m_sigma, m_kernelSize);
+    detector.setTimers(false);
+    return detector;
+}
+
+BatchReport BatchEdgeDetection::process(const std::vector<cv::Mat>& images, std::vector<cv::Mat>& edges)
+{
+    const int threads = m_threads > 0 ? m_threads : omp_get_max_threads();
+    edges.resize(images.size());
+
+    BatchReport report;
+    report.images = images.size();
+    std::vector<size_t> smallImages;
+    std::vector<size_t> largeImages;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        report.pixels += images[i].total();
+        (images[i].total() <= m_smallImagePixels ? smallImages : largeImages).push_back(i);
+    }
+
+    // Only the error of the first failing image is kept, so the outcome doesn't depend on the schedule
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    size_t errorIndex = images.size();
+    auto run = [&](size_t i) {
+        try
+        {
+            EdgeDetection detector = makeDetector();
+            detector.cannyEdgeDetection(images[i], edges[i]);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (i < errorIndex)
+            {
+                errorIndex = i;
+                error = std::current_exception();
+            }
+        }
+    };
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // Large images have enough rows to split every stage across the threads
+    const int previousThreads = omp_get_max_threads();
+    omp_set_num_threads(threads);
+    for (size_t i : largeImages)
+    {
+        run(i);
+    }
+    omp_set_num_threads(previousThreads);
+
+    // Small images run one per task. The thread count set inside a task only applies to the parallel regions of
+    // that task, so the stages of every image run serially on the thread that picked it
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp single
+        {
+            for (size_t i : smallImages)
+            {
+                #pragma omp task firstprivate(i)
+                {
+                    omp_set_num_threads(1);
+                    run(i);
+                }
+            }
+        }
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    report.seconds = duration.count();
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] Batch of " << report.images << " images (" << largeImages.size() << " large) with "
+                  << threads << " threads: " << report.seconds << " seconds, " << report.imagesPerSecond()
+                  << " images/s\n";
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return report;
+}
@@ -1,162 +1,616 @@
 #include "cannyEdgeFilter.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <omp.h>
+#include <sched.h>
+#include <type_traits>
 
-EdgeDetection::EdgeDetection(float lowThreshold, float highThreshold, float sigma)
-    : m_lowThreshold(lowThreshold)
-    , m_highThreshold(highThreshold)
-    , m_sigma(sigma)
+namespace
 {
-}
+// Rows of the output produced by each task of the fused pipeline. Every strip recomputes a few halo rows above and
+// below it, so strips much shorter than this waste work, and much longer ones balance worse between threads
+constexpr int STRIP_ROWS = 64;
+
+// Types of the blur of each precision. In fixed point the weights have BLUR_FRACTION_BITS fraction bits and sum to
+// one, so a horizontal sum of 8-bit pixels fits uint16 and a vertical sum of those fits uint32
+template <Precision P>
+struct BlurTypes
+{
+    using Weight = float;
+    using Horizontal = float; // Horizontal pass output
+    using Accum = float;      // Vertical pass sums
+    static constexpr int HORIZONTAL_TYPE = CV_32F;
+};
 
-void EdgeDetection::applyGaussianBlur(const std::string& outputImage)
+template <>
+struct BlurTypes<Precision::FixedPoint>
 {
-    cv::Mat image_tmp(m_originalImage.rows + KERNEL_SIZE - 1,
-                      m_originalImage.cols + KERNEL_SIZE - 1,
-                      m_originalImage.type());        // Necessary to handle borders
-    cv::Mat kernel(KERNEL_SIZE, KERNEL_SIZE, CV_64F); // CV_64F cuz it's storing double
-    double kmean = KERNEL_SIZE / 2;                   // To calculate the gaussian function
-    double kaccum = 0;                                // Necessary to posteriori normalization
-    int border_val = 0;                               // Value filled in the border
-    int half_kernel_size = KERNEL_SIZE / 2;           // An offset, respect to kernel center
-    double blur_accum = 0;                            // Accumulate the value for the blurred pixel
+    using Weight = uint16_t;
+    using Horizontal = uint16_t;
+    using Accum = uint32_t;
+    static constexpr int HORIZONTAL_TYPE = CV_16U;
+};
+
+// Horizontal pass of the separable blur over one row. Taps outside the image count as zero
+template <int Size, typename Weight, typename Horizontal>
+void horizontalBlurRow(const uint8_t* src, Horizontal* dst, int cols, const Weight* kernel)
+{
+    constexpr int half_kernel_size = Size / 2;
+
+    // Columns whose taps fall outside the image only accumulate the valid ones
+    auto borderPixel = [&](int col) {
+        Horizontal blur_accum = 0;
+        for (int kcol = -half_kernel_size; kcol <= half_kernel_size; kcol++)
+        {
+            if (col + kcol >= 0 && col + kcol < cols)
+            {
+                blur_accum += static_cast<Horizontal>(src[col + kcol]) * kernel[kcol + half_kernel_size];
+            }
+        }
+        dst[col] = blur_accum;
+    };
 
-    // 1. Create temporal image with extra borders
-    #pragma omp parallel for collapse(2)
-    for (int row = 0; row < half_kernel_size; row++)
+    const int interior_end = std::max(half_kernel_size, cols - half_kernel_size);
+    for (int col = 0; col < std::min(half_kernel_size, cols); col++)
+    {
+        borderPixel(col);
+    }
+    for (int col = half_kernel_size; col < interior_end; col++)
     {
-        for (int col = 0; col < image_tmp.cols; col++)
+        Horizontal blur_accum = 0;
+        for (int kcol = 0; kcol < Size; kcol++)
         {
-            image_tmp.at<uchar>(row, col) = static_cast<uchar>(border_val);
+            blur_accum += static_cast<Horizontal>(src[col + kcol - half_kernel_size]) * kernel[kcol];
         }
+        dst[col] = blur_accum;
+    }
+    for (int col = interior_end; col < cols; col++)
+    {
+        borderPixel(col);
     }
+}
 
-    #pragma omp parallel for collapse(2)
-    for (int row = image_tmp.rows - half_kernel_size; row < image_tmp.rows; row++)
+// Vertical pass of the separable blur for one row, from the horizontally blurred rows that fall inside the image.
+// accum is a scratch row of cols sums. Both precisions truncate the result
+template <typename Weight, typename Horizontal, typename Accum>
+void verticalBlurRow(const Horizontal* const* src, const Weight* weights, int taps, Accum* accum, uint8_t* dst,
+                     int cols)
+{
+    std::fill(accum, accum + cols, Accum(0));
+    for (int tap = 0; tap < taps; tap++)
     {
-        for (int col = 0; col < image_tmp.cols; col++)
+        const Horizontal* row = src[tap];
+        const Accum weight = weights[tap];
+        for (int col = 0; col < cols; col++)
         {
-            image_tmp.at<uchar>(row, col) = static_cast<uchar>(border_val);
+            accum[col] += static_cast<Accum>(row[col]) * weight;
         }
     }
+    for (int col = 0; col < cols; col++)
+    {
+        if constexpr (std::is_floating_point_v<Accum>)
+        {
+            dst[col] = static_cast<uint8_t>(accum[col]);
+        }
+        else
+        {
+            dst[col] = static_cast<uint8_t>(accum[col] >> (2 * BLUR_FRACTION_BITS));
+        }
+    }
+}
 
-    #pragma omp parallel for collapse(2)
-    for (int col = 0; col < half_kernel_size; col++)
+// Collects the horizontally blurred rows (and their weights) that the vertical pass of a row needs
+template <int Size, typename Weight, typename Horizontal, typename RowGetter>
+int gatherVerticalTaps(int row, int rows, const Weight* kernel, RowGetter horizontalRow, const Horizontal** src,
+                       Weight* weights)
+{
+    constexpr int half_kernel_size = Size / 2;
+    int taps = 0;
+    for (int krow = -half_kernel_size; krow <= half_kernel_size; krow++)
     {
-        for (int row = 0; row < image_tmp.rows; row++)
+        if (row + krow >= 0 && row + krow < rows)
         {
-            image_tmp.at<uchar>(row, col) = static_cast<uchar>(border_val);
+            src[taps] = horizontalRow(row + krow);
+            weights[taps] = kernel[krow + half_kernel_size];
+            taps++;
         }
     }
+    return taps;
+}
 
-    #pragma omp parallel for collapse(2)
-    for (int col = image_tmp.cols - half_kernel_size; col < image_tmp.cols; col++)
+// Non-maximum suppression of one row. The first and last columns are always suppressed
+void suppressRow(const uint16_t* above, const uint16_t* center, const uint16_t* below, const uint8_t* direction,
+                 uint8_t* edges, int cols)
+{
+    for (int j = 1; j < cols - 1; ++j)
     {
-        for (int row = 0; row < image_tmp.rows; row++)
+        uint16_t neighbor_q;
+        uint16_t neighbor_r;
+
+        // Determine the neighbors to compare based on the gradient direction sector
+        switch (direction[j])
+        {
+        case SobelKernels::DIRECTION_45:
+            neighbor_q = below[j - 1];
+            neighbor_r = above[j + 1];
+            break;
+        case SobelKernels::DIRECTION_90:
+            neighbor_q = below[j];
+            neighbor_r = above[j];
+            break;
+        case SobelKernels::DIRECTION_135:
+            neighbor_q = above[j - 1];
+            neighbor_r = below[j + 1];
+            break;
+        default:
+            neighbor_q = center[j + 1];
+            neighbor_r = center[j - 1];
+            break;
+        }
+
+        uint16_t central = center[j];
+        if (central >= neighbor_q && central >= neighbor_r)
         {
-            image_tmp.at<uchar>(row, col) = static_cast<uchar>(border_val);
+            // Keep as maximum, back to whole intensity levels
+            edges[j] = static_cast<uint8_t>(std::min(central >> SobelKernels::MAGNITUDE_FRACTION_BITS, 255));
         }
+        else
+        {
+            edges[j] = 0; // Suppress
+        }
+    }
+    edges[0] = 0;
+    edges[cols - 1] = 0;
+}
+
+// Streams the blurred Sobel gradient of an image row by row. Row y of every stage lives in slot y % slots of a small
+// rolling buffer, as each stage only needs the rows of the previous one that are inside its kernel, so a handful of
+// rows stays resident in cache. Rows 0 and rows - 1 have zero gradient
+template <int Size, Precision P>
+class GradientStream
+{
+public:
+    using Weight = typename BlurTypes<P>::Weight;
+    using Horizontal = typename BlurTypes<P>::Horizontal;
+    using Accum = typename BlurTypes<P>::Accum;
+
+    GradientStream(int cols, const Weight* kernel, SobelKernels::SobelRowFn sobelRow)
+        : m_cols(cols)
+        , m_kernel(kernel)
+        , m_sobelRow(sobelRow)
+        , m_horizontal(WorkspacePool::instance().acquire(Size, cols, BlurTypes<P>::HORIZONTAL_TYPE))
+        , m_blurred(WorkspacePool::instance().acquire(3, cols, CV_8U))
+        , m_magnitude(WorkspacePool::instance().acquire(3, cols, CV_16U))
+        , m_direction(WorkspacePool::instance().acquire(3, cols, CV_8U))
+        , m_accum(WorkspacePool::instance().acquire(1, cols, CV_32F)) // float and uint32 sums are the same size
+    {
     }
 
-    #pragma omp parallel for collapse(2)
-    for (int row = 0; row < m_originalImage.rows; row++)
+    // Restarts the stream at a strip of the image, the first gradient row it produces is firstRow - 1
+    void reset(const cv::Mat& image, int firstRow)
     {
-        for (int col = 0; col < m_originalImage.cols; col++)
+        m_image = &image;
+        m_nextSobel = std::max(0, firstRow - 1);
+        m_nextBlur = std::max(0, m_nextSobel - 1);
+        m_nextHorizontal = std::max(0, m_nextBlur - Size / 2);
+    }
+
+    // Produces the gradient rows up to row, which stay available until three more rows are produced
+    void advanceTo(int row)
+    {
+        const int rows = m_image->rows;
+        for (; m_nextSobel <= row; ++m_nextSobel)
         {
-            image_tmp.at<uchar>(row + half_kernel_size, col + half_kernel_size) = m_originalImage.at<uchar>(row, col);
+            uint16_t* mag = magnitudeRow(m_nextSobel);
+            uint8_t* dir = directionRow(m_nextSobel);
+            if (m_nextSobel == 0 || m_nextSobel == rows - 1)
+            {
+                std::fill(mag, mag + m_cols, 0);
+                std::fill(dir, dir + m_cols, SobelKernels::DIRECTION_0);
+                continue;
+            }
+
+            // The Sobel row needs the blurred rows around it, which need the horizontally blurred rows around them
+            for (; m_nextBlur <= m_nextSobel + 1; ++m_nextBlur)
+            {
+                for (; m_nextHorizontal <= std::min(rows - 1, m_nextBlur + Size / 2); ++m_nextHorizontal)
+                {
+                    horizontalBlurRow<Size>(
+                        m_image->ptr<uint8_t>(m_nextHorizontal), horizontalRow(m_nextHorizontal), m_cols, m_kernel);
+                }
+                const Horizontal* src[Size];
+                Weight weights[Size];
+                int taps = gatherVerticalTaps<Size>(
+                    m_nextBlur, rows, m_kernel, [this](int y) { return horizontalRow(y); }, src, weights);
+                verticalBlurRow(src, weights, taps, m_accum.mat().ptr<Accum>(), blurredRow(m_nextBlur), m_cols);
+            }
+
+            m_sobelRow(blurredRow(m_nextSobel - 1), blurredRow(m_nextSobel), blurredRow(m_nextSobel + 1), mag, dir,
+                       m_cols);
+            mag[0] = mag[m_cols - 1] = 0;
+            dir[0] = dir[m_cols - 1] = SobelKernels::DIRECTION_0;
         }
     }
 
-    // 2. Create Kernel
-    #pragma omp parallel for collapse(2) reduction(+:kaccum)
-    for (int x = 0; x < KERNEL_SIZE; ++x)
+    uint16_t* magnitudeRow(int y)
+    {
+        return m_magnitude.mat().ptr<uint16_t>(y % 3);
+    }
+
+    uint8_t* directionRow(int y)
+    {
+        return m_direction.mat().ptr<uint8_t>(y % 3);
+    }
+
+private:
+    Horizontal* horizontalRow(int y)
+    {
+        return m_horizontal.mat().ptr<Horizontal>(y % Size);
+    }
+
+    uint8_t* blurredRow(int y)
+    {
+        return m_blurred.mat().ptr<uint8_t>(y % 3);
+    }
+
+    int m_cols;
+    const Weight* m_kernel;
+    SobelKernels::SobelRowFn m_sobelRow;
+    WorkspacePool::Lease m_horizontal;
+    WorkspacePool::Lease m_blurred;
+    WorkspacePool::Lease m_magnitude;
+    WorkspacePool::Lease m_direction;
+    WorkspacePool::Lease m_accum;
+    const cv::Mat* m_image = nullptr;
+    int m_nextSobel = 0;
+    int m_nextBlur = 0;
+    int m_nextHorizontal = 0;
+};
+
+// Combines the gradients of several bands at row y into a single magnitude and direction. The direction is the one
+// of the band with the largest (weighted) magnitude, the first one on ties. Empty weights are 1 for Max and 1 / bands
+// for WeightedSum
+template <typename Stream>
+void combineBandRows(std::vector<Stream>& bands,
+                     int y,
+                     BandCombination combination,
+                     const std::vector<float>& weights,
+                     uint16_t* magnitude,
+                     uint8_t* direction,
+                     int cols)
+{
+    const float defaultWeight = combination == BandCombination::Max ? 1.0f : 1.0f / bands.size();
+    for (int col = 0; col < cols; ++col)
     {
-        for (int y = 0; y < KERNEL_SIZE; ++y)
+        float best = -1.0f;
+        float sum = 0.0f;
+        uint8_t bestDirection = SobelKernels::DIRECTION_0;
+        for (size_t band = 0; band < bands.size(); ++band)
         {
-            kernel.at<double>(x, y) = exp(-0.5 * (pow((x - kmean) / m_sigma, 2.0) + pow((y - kmean) / m_sigma, 2.0))) /
-                                      (2 * M_PI * m_sigma * m_sigma);
-            kaccum += kernel.at<double>(x, y);
+            const float value =
+                bands[band].magnitudeRow(y)[col] * (weights.empty() ? defaultWeight : weights[band]);
+            sum += value;
+            if (value > best)
+            {
+                best = value;
+                bestDirection = bands[band].directionRow(y)[col];
+            }
         }
+        const float combined = combination == BandCombination::Max ? best : sum;
+        magnitude[col] = static_cast<uint16_t>(std::min(combined, 65535.0f));
+        direction[col] = bestDirection;
     }
-    kernel /= kaccum; // Normalization
+}
 
-    // 3. Apply filter
-    auto start_time = std::chrono::steady_clock::now();
-    #pragma omp parallel for collapse(2) private(blur_accum)
-    for (int imrow = half_kernel_size; imrow < image_tmp.rows - half_kernel_size; imrow++)
+// Averages every factor x factor block of the image into one pixel of reduced, which has ceil(rows / factor) x
+// ceil(cols / factor) pixels. Blocks cut by the right or bottom border average the pixels they have
+void boxDownsample(const cv::Mat& image, cv::Mat& reduced, int factor)
+{
+    #pragma omp parallel
     {
-        for (int imcol = half_kernel_size; imcol < image_tmp.cols - half_kernel_size; imcol++)
+        WorkspacePool::Lease sumsLease = WorkspacePool::instance().acquire(1, reduced.cols, CV_32S);
+        uint32_t* sums = sumsLease.mat().ptr<uint32_t>();
+
+        #pragma omp for
+        for (int row = 0; row < reduced.rows; row++)
         {
-            blur_accum = 0;
-            for (int krow = -half_kernel_size; krow <= half_kernel_size; krow++)
+            const int firstRow = row * factor;
+            const int lastRow = std::min(firstRow + factor, image.rows);
+            std::fill(sums, sums + reduced.cols, 0);
+            for (int y = firstRow; y < lastRow; y++)
             {
-                for (int kcol = -half_kernel_size; kcol <= half_kernel_size; kcol++)
+                const uint8_t* in = image.ptr<uint8_t>(y);
+                for (int col = 0, x = 0; col < reduced.cols; col++)
                 {
-                    blur_accum += static_cast<double>(image_tmp.at<uchar>(imrow + krow, imcol + kcol)) *
-                                  kernel.at<double>(krow + half_kernel_size, kcol + half_kernel_size);
+                    const int lastCol = std::min(x + factor, image.cols);
+                    uint32_t sum = 0;
+                    for (; x < lastCol; x++)
+                    {
+                        sum += in[x];
+                    }
+                    sums[col] += sum;
                 }
             }
-            m_cannyEdges.at<uint8_t>(imrow - half_kernel_size, imcol - half_kernel_size) =
-                static_cast<uint8_t>(blur_accum);
+
+            uint8_t* out = reduced.ptr<uint8_t>(row);
+            for (int col = 0; col < reduced.cols; col++)
+            {
+                const uint32_t count = (lastRow - firstRow) * (std::min((col + 1) * factor, image.cols) - col * factor);
+                out[col] = static_cast<uint8_t>((sums[col] + count / 2) / count);
+            }
         }
     }
-    auto end_time = std::chrono::steady_clock::now();
-    std::chrono::duration<double> duration = end_time - start_time;
-    std::cout << "[TIMER] apllyFilterLoop: " << duration.count() << " seconds\n";
+}
 
-    m_imageFileOperations->saveImage(outputImage + "gauss.png", m_cannyEdges);
+// Calls fn with the kernel size as a compile time constant, so every supported size gets its own fully unrolled loops
+template <typename Fn>
+void dispatchKernelSize(int kernelSize, Fn&& fn)
+{
+    switch (kernelSize)
+    {
+    case 3:
+        fn(std::integral_constant<int, 3>());
+        break;
+    case 5:
+        fn(std::integral_constant<int, 5>());
+        break;
+    case 7:
+        fn(std::integral_constant<int, 7>());
+        break;
+    default:
+        throw std::runtime_error("Unsupported kernel size: " + std::to_string(kernelSize));
+    }
 }
 
-void EdgeDetection::sobelOperator(const std::string& outputImage)
+// Calls fn with the kernel size and the blur precision as compile time constants
+template <typename Fn>
+void dispatchBlur(int kernelSize, Precision precision, Fn&& fn)
 {
-    int rows = m_originalImage.rows;
-    int cols = m_originalImage.cols;
+    dispatchKernelSize(kernelSize, [&](auto size) {
+        if (precision == Precision::FixedPoint)
+        {
+            fn(size, std::integral_constant<Precision, Precision::FixedPoint>());
+        }
+        else
+        {
+            fn(size, std::integral_constant<Precision, Precision::Float>());
+        }
+    });
+}
+
+// The blur weights of a precision
+template <Precision P>
+const typename BlurTypes<P>::Weight* selectKernel(const float* floatKernel, const uint16_t* fixedPointKernel)
+{
+    if constexpr (P == Precision::FixedPoint)
+    {
+        return fixedPointKernel;
+    }
+    else
+    {
+        return floatKernel;
+    }
+}
 
-    m_magnitude.create(rows, cols, CV_32F);
-    m_direction.create(rows, cols, CV_32F);
+// Schedule of the strip loops, schedule(runtime), while the object lives. Strips on demand balance the load better,
+// blocks of strips keep every row on the thread and the node that worked on it in the previous run
+class StripSchedule
+{
+public:
+    explicit StripSchedule(ThreadAffinity affinity)
+    {
+        omp_get_schedule(&m_previousKind, &m_previousChunk);
+        omp_set_schedule(affinity == ThreadAffinity::None ? omp_sched_dynamic : omp_sched_static, 0);
+    }
 
-    // Sobel kernels for edge detection in x and y directions
-    const int8_t sobelX[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-    const int8_t sobelY[3][3] = {{1, 2, 1}, {0, 0, 0}, {-1, -2, -1}};
+    ~StripSchedule()
+    {
+        omp_set_schedule(m_previousKind, m_previousChunk);
+    }
 
-    // Calculate gradients
-    cv::Mat gradientX(rows, cols, CV_32F, cv::Scalar(0));
-    cv::Mat gradientY(rows, cols, CV_32F, cv::Scalar(0));
+    StripSchedule(const StripSchedule&) = delete;
+    StripSchedule& operator=(const StripSchedule&) = delete;
 
-    auto start_time = std::chrono::steady_clock::now();
-    #pragma omp parallel for collapse(2)
-    for (int rowIndex = 1; rowIndex < rows - 1; ++rowIndex)
+private:
+    omp_sched_t m_previousKind;
+    int m_previousChunk;
+};
+
+// Placement of the threads of a job as set by setThreadAffinity(), while the object lives. The caller is thread 0 of
+// the team, it gets its own CPUs back when the job ends, so the threads it starts afterwards aren't stuck on the CPUs
+// of thread 0. The other threads of the team stay pinned for the next job
+class ThreadPlacement
+{
+public:
+    explicit ThreadPlacement(ThreadAffinity affinity)
     {
-        for (int colIndex = 1; colIndex < cols - 1; ++colIndex)
+        // A team already running keeps its placement, a single thread team would be pinned to the first node
+        m_pinned = affinity != ThreadAffinity::None && !omp_in_parallel() &&
+                   sched_getaffinity(0, sizeof(m_callerCpus), &m_callerCpus) == 0;
+        if (m_pinned)
         {
-            float gx = 0, gy = 0;
-            for (int kernelRowIndex = -1; kernelRowIndex <= 1; ++kernelRowIndex)
-            {
-                for (int kernelColIndex = -1; kernelColIndex <= 1; ++kernelColIndex)
-                {
-                    // Fetch the pixel value from the preprocessed image (cannyEdges)
-                    uchar pixelValue = m_cannyEdges.at<uchar>(rowIndex + kernelRowIndex, colIndex + kernelColIndex);
+            NumaPlacement::pinThreads(affinity);
+        }
+    }
 
-                    // Apply Sobel X kernel
-                    gx += pixelValue * sobelX[kernelRowIndex + 1][kernelColIndex + 1];
+    ~ThreadPlacement()
+    {
+        if (m_pinned)
+        {
+            sched_setaffinity(0, sizeof(m_callerCpus), &m_callerCpus);
+        }
+    }
 
-                    // Apply Sobel Y kernel
-                    gy += pixelValue * sobelY[kernelRowIndex + 1][kernelColIndex + 1];
-                }
-            }
+    ThreadPlacement(const ThreadPlacement&) = delete;
+    ThreadPlacement& operator=(const ThreadPlacement&) = delete;
+
+private:
+    bool m_pinned;
+    cpu_set_t m_callerCpus;
+};
+} // namespace
 
-            // Store computed gradients
-            gradientX.at<float>(rowIndex, colIndex) = gx;
-            gradientY.at<float>(rowIndex, colIndex) = gy;
+EdgeDetection::EdgeDetection(float lowThreshold, float highThreshold, float sigma, int kernelSize)
+    : m_lowThreshold(lowThreshold)
+    , m_highThreshold(highThreshold)
+    , m_sigma(sigma)
+    , m_kernelSize(kernelSize)
+    , m_thresholds {lowThreshold, highThreshold}
+    , m_simdLevel(SobelKernels::detectSimdLevel())
+    , m_imageFileOperations(std::make_shared<ImageFileOperations>())
+{
+    if (kernelSize != 3 && kernelSize != 5 && kernelSize != 7)
+    {
+        throw std::runtime_error("Unsupported kernel size: " + std::to_string(kernelSize));
+    }
+}
+
+const std::vector<float>& EdgeDetection::getGaussianKernel(float sigma, int kernelSize)
+{
+    static std::mutex cacheMutex;
+    static std::map<std::pair<float, int>, std::vector<float>> kernelCache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto cached = kernelCache.find({sigma, kernelSize});
+    if (cached != kernelCache.end())
+    {
+        return cached->second;
+    }
 
-            // Calculate magnitude and direction
-            m_magnitude.at<float>(rowIndex, colIndex) = std::sqrt(gx * gx + gy * gy);
-            m_direction.at<float>(rowIndex, colIndex) = std::atan2(gy, gx);
+    // The 2D gaussian is the outer product of two 1D gaussians, so a normalized 1D kernel is enough
+    std::vector<double> weights(kernelSize);
+    double kmean = kernelSize / 2; // To calculate the gaussian function
+    double kaccum = 0;             // Necessary to posteriori normalization
+    for (int x = 0; x < kernelSize; ++x)
+    {
+        weights[x] = exp(-0.5 * pow((x - kmean) / sigma, 2.0));
+        kaccum += weights[x];
+    }
+
+    std::vector<float> kernel(kernelSize);
+    for (int x = 0; x < kernelSize; ++x)
+    {
+        kernel[x] = static_cast<float>(weights[x] / kaccum); // Normalization
+    }
+    return kernelCache.emplace(std::make_pair(sigma, kernelSize), std::move(kernel)).first->second;
+}
+
+const std::vector<uint16_t>& EdgeDetection::getFixedPointKernel(float sigma, int kernelSize)
+{
+    static std::mutex cacheMutex;
+    static std::map<std::pair<float, int>, std::vector<uint16_t>> kernelCache;
+
+    const std::vector<float>& weights = getGaussianKernel(sigma, kernelSize);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto cached = kernelCache.find({sigma, kernelSize});
+    if (cached != kernelCache.end())
+    {
+        return cached->second;
+    }
+
+    // Rounded weights, with the rounding error moved to the center one so flat areas stay flat
+    constexpr int one = 1 << BLUR_FRACTION_BITS;
+    std::vector<uint16_t> kernel(kernelSize);
+    int sum = 0;
+    for (int x = 0; x < kernelSize; ++x)
+    {
+        kernel[x] = static_cast<uint16_t>(std::lround(weights[x] * one));
+        sum += kernel[x];
+    }
+    kernel[kernelSize / 2] = static_cast<uint16_t>(kernel[kernelSize / 2] + one - sum);
+    return kernelCache.emplace(std::make_pair(sigma, kernelSize), std::move(kernel)).first->second;
+}
+
+void EdgeDetection::applyGaussianBlur()
+{
+    const int rows = m_originalImage.rows;
+    const int cols = m_originalImage.cols;
+    const float* floatKernel = getGaussianKernel(m_sigma, m_kernelSize).data();
+    const uint16_t* fixedPointKernel = getFixedPointKernel(m_sigma, m_kernelSize).data();
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    dispatchBlur(m_kernelSize, m_precision, [&](auto size, auto precision) {
+        constexpr int Size = decltype(size)::value;
+        constexpr Precision P = decltype(precision)::value;
+        using Types = BlurTypes<P>;
+        const typename Types::Weight* kernel = selectKernel<P>(floatKernel, fixedPointKernel);
+
+        // Result of the horizontal pass. Pixels outside the image are treated as zero by both passes, which is the
+        // same as blurring a copy padded with a zero border
+        WorkspacePool::Lease horizontalLease = WorkspacePool::instance().acquire(rows, cols, Types::HORIZONTAL_TYPE);
+        cv::Mat& horizontal = horizontalLease.mat();
+
+        // 1. Horizontal pass
+        #pragma omp parallel for
+        for (int row = 0; row < rows; row++)
+        {
+            horizontalBlurRow<Size>(m_originalImage.ptr<uint8_t>(row),
+                                    horizontal.ptr<typename Types::Horizontal>(row), cols, kernel);
         }
+
+        // 2. Vertical pass
+        #pragma omp parallel
+        {
+            // Float and uint32 sums are the same size
+            WorkspacePool::Lease accumLease = WorkspacePool::instance().acquire(1, cols, CV_32F);
+            typename Types::Accum* accum = accumLease.mat().ptr<typename Types::Accum>();
+
+            #pragma omp for
+            for (int row = 0; row < rows; row++)
+            {
+                const typename Types::Horizontal* src[Size];
+                typename Types::Weight weights[Size];
+                int taps = gatherVerticalTaps<Size>(
+                    row, rows, kernel, [&](int y) { return horizontal.ptr<typename Types::Horizontal>(y); }, src,
+                    weights);
+                verticalBlurRow(src, weights, taps, accum, m_cannyEdges.ptr<uint8_t>(row), cols);
+            }
+        }
+    });
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] apllyFilterLoop: " << duration.count() << " seconds\n";
+    }
+    m_stageTimes.gaussianBlur = duration.count();
+
+    saveDebugImage("gauss.png", m_cannyEdges);
+}
+
+void EdgeDetection::sobelOperator()
+{
+    int rows = m_originalImage.rows;
+    int cols = m_originalImage.cols;
+
+    // m_magnitude and m_direction are leased from the pool by cannyEdgeDetection(), with the size of the image
+
+    // Best row kernel for this CPU, resolved once per process
+    const SobelKernels::SobelRowFn sobelRow = SobelKernels::getSobelRow(m_simdLevel, m_gradientNorm);
+
+    auto start_time = std::chrono::steady_clock::now();
+    #pragma omp parallel for
+    for (int rowIndex = 1; rowIndex < rows - 1; ++rowIndex)
+    {
+        sobelRow(m_cannyEdges.ptr<uint8_t>(rowIndex - 1),
+                 m_cannyEdges.ptr<uint8_t>(rowIndex),
+                 m_cannyEdges.ptr<uint8_t>(rowIndex + 1),
+                 m_magnitude.ptr<uint16_t>(rowIndex),
+                 m_direction.ptr<uint8_t>(rowIndex),
+                 cols);
     }
     auto end_time = std::chrono::steady_clock::now();
     std::chrono::duration<double> duration = end_time - start_time;
-    std::cout << "[TIMER] SobelOperator: " << duration.count() << " seconds\n";
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] SobelOperator (" << SobelKernels::simdLevelName(m_simdLevel)
+                  << "): " << duration.count() << " seconds\n";
+    }
+    m_stageTimes.sobel = duration.count();
 
     // Set border pixels to zero
     m_magnitude.row(0).setTo(0);
@@ -164,173 +618,464 @@ void EdgeDetection::sobelOperator(const std::string& outputImage)
     m_magnitude.col(0).setTo(0);
     m_magnitude.col(cols - 1).setTo(0);
 
-    m_direction.row(0).setTo(0);
-    m_direction.row(rows - 1).setTo(0);
-    m_direction.col(0).setTo(0);
-    m_direction.col(cols - 1).setTo(0);
-
-    // Normalize the direction for visualization purposes
-    cv::normalize(m_direction, m_direction, 0, 255, cv::NORM_MINMAX);
+    m_direction.row(0).setTo(cv::Scalar(SobelKernels::DIRECTION_0));
+    m_direction.row(rows - 1).setTo(cv::Scalar(SobelKernels::DIRECTION_0));
+    m_direction.col(0).setTo(cv::Scalar(SobelKernels::DIRECTION_0));
+    m_direction.col(cols - 1).setTo(cv::Scalar(SobelKernels::DIRECTION_0));
 
-    // Save the processed image for verification
-    m_imageFileOperations->saveImage(outputImage + "sobelDirection.png",
-                                     m_direction); // Saving the direction as an image for visualization
-    m_imageFileOperations->saveImage(outputImage + "sobelMagnitude.png",
-                                     m_magnitude); // Saving the direction as an image for visualization
+    // Save the processed image for verification. The sector codes are spread over 0-255 for visualization purposes,
+    // only when there is a debug output to save them to
+    if (!m_debugOutput.empty())
+    {
+        cv::Mat directionImage;
+        m_direction.convertTo(directionImage, CV_8U, 85);
+        saveDebugImage("sobelDirection.png", directionImage);
+        saveDebugImage("sobelMagnitude.png", m_magnitude);
+    }
 }
 
-void EdgeDetection::nonMaximumSuppression(const std::string& outputImage)
+void EdgeDetection::nonMaximumSuppression()
 {
     int rows = m_magnitude.rows;
     int cols = m_magnitude.cols;
 
-    #pragma omp parallel for collapse(2)
+    auto start_time = std::chrono::steady_clock::now();
+    #pragma omp parallel for
     for (int i = 1; i < rows - 1; ++i)
     {
-        for (int j = 1; j < cols - 1; ++j)
+        suppressRow(m_magnitude.ptr<uint16_t>(i - 1), m_magnitude.ptr<uint16_t>(i), m_magnitude.ptr<uint16_t>(i + 1),
+                    m_direction.ptr<uint8_t>(i), m_cannyEdges.ptr<uint8_t>(i), cols);
+    }
+
+    // Handle borders separately
+    m_cannyEdges.row(0).setTo(0);
+    m_cannyEdges.row(rows - 1).setTo(0);
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] nonMaximumSuppression: " << duration.count() << " seconds\n";
+    }
+    m_stageTimes.nonMaximumSuppression = duration.count();
+
+    saveDebugImage("maxsupress.png", m_cannyEdges);
+}
+
+void EdgeDetection::fusedBlurSobelSuppression()
+{
+    const int rows = m_originalImage.rows;
+    const int cols = m_originalImage.cols;
+    const float* floatKernel = getGaussianKernel(m_sigma, m_kernelSize).data();
+    const uint16_t* fixedPointKernel = getFixedPointKernel(m_sigma, m_kernelSize).data();
+    const SobelKernels::SobelRowFn sobelRow = SobelKernels::getSobelRow(m_simdLevel, m_gradientNorm);
+    const int strips = (rows + STRIP_ROWS - 1) / STRIP_ROWS;
+    const StripSchedule schedule(m_threadAffinity);
+
+    dispatchBlur(m_kernelSize, m_precision, [&](auto size, auto precision) {
+        constexpr int Size = decltype(size)::value;
+        constexpr Precision P = decltype(precision)::value;
+        const typename BlurTypes<P>::Weight* kernel = selectKernel<P>(floatKernel, fixedPointKernel);
+
+        #pragma omp parallel
         {
-            float neighbor_q = 255;
-            float neighbor_r = 255;
+            GradientStream<Size, P> gradient(cols, kernel, sobelRow);
 
-            // Get angle in degrees
-            float angle = (m_direction.at<float>(i, j) - 128) * 180.0 / 128;
-            if (angle < 0)
+            #pragma omp for schedule(runtime)
+            for (int strip = 0; strip < strips; ++strip)
             {
-                angle += 180;
-            }
+                const int firstRow = strip * STRIP_ROWS;
+                const int lastRow = std::min(rows, firstRow + STRIP_ROWS);
 
-            // Determine the neighbors to compare based on the gradient direction
-            if ((0 <= angle && angle < 22.5) || (157.5 <= angle && angle <= 180))
-            {
-                neighbor_q = m_magnitude.at<float>(i, j + 1);
-                neighbor_r = m_magnitude.at<float>(i, j - 1);
-            }
-            else if (22.5 <= angle && angle < 67.5)
-            {
-                neighbor_q = m_magnitude.at<float>(i + 1, j - 1);
-                neighbor_r = m_magnitude.at<float>(i - 1, j + 1);
-            }
-            else if (67.5 <= angle && angle < 112.5)
-            {
-                neighbor_q = m_magnitude.at<float>(i + 1, j);
-                neighbor_r = m_magnitude.at<float>(i - 1, j);
-            }
-            else if (112.5 <= angle && angle < 157.5)
-            {
-                neighbor_q = m_magnitude.at<float>(i - 1, j - 1);
-                neighbor_r = m_magnitude.at<float>(i + 1, j + 1);
+                gradient.reset(m_originalImage, firstRow);
+                for (int row = firstRow; row < lastRow; ++row)
+                {
+                    // Suppressing a row needs the gradient of its neighbors
+                    gradient.advanceTo(std::min(rows - 1, row + 1));
+
+                    uint8_t* edges = m_cannyEdges.ptr<uint8_t>(row);
+                    if (row == 0 || row == rows - 1)
+                    {
+                        std::fill(edges, edges + cols, 0);
+                        continue;
+                    }
+                    suppressRow(gradient.magnitudeRow(row - 1),
+                                gradient.magnitudeRow(row),
+                                gradient.magnitudeRow(row + 1),
+                                gradient.directionRow(row),
+                                edges,
+                                cols);
+                }
             }
+        }
+    });
+}
+
+void EdgeDetection::fusedMultiBandSuppression(const std::vector<cv::Mat>& bands,
+                                              BandCombination combination,
+                                              const std::vector<float>& weights)
+{
+    const int rows = bands.front().rows;
+    const int cols = bands.front().cols;
+    const float* floatKernel = getGaussianKernel(m_sigma, m_kernelSize).data();
+    const uint16_t* fixedPointKernel = getFixedPointKernel(m_sigma, m_kernelSize).data();
+    const SobelKernels::SobelRowFn sobelRow = SobelKernels::getSobelRow(m_simdLevel, m_gradientNorm);
+    const int strips = (rows + STRIP_ROWS - 1) / STRIP_ROWS;
+    const StripSchedule schedule(m_threadAffinity);
+
+    dispatchBlur(m_kernelSize, m_precision, [&](auto size, auto precision) {
+        constexpr int Size = decltype(size)::value;
+        constexpr Precision P = decltype(precision)::value;
+        const typename BlurTypes<P>::Weight* kernel = selectKernel<P>(floatKernel, fixedPointKernel);
 
-            float central = m_magnitude.at<float>(i, j);
-            if (central >= neighbor_q && central >= neighbor_r)
+        #pragma omp parallel
+        {
+            // The vector of every thread keeps its capacity across jobs, like the hysteresis stacks. The streams, and
+            // the buffers they lease, are released at the end of the job
+            static thread_local std::vector<GradientStream<Size, P>> gradients;
+            gradients.clear();
+            gradients.reserve(bands.size());
+            for (size_t band = 0; band < bands.size(); ++band)
             {
-                m_cannyEdges.at<uint8_t>(i, j) = static_cast<uint8_t>(central); // Keep as maximum
+                gradients.emplace_back(cols, kernel, sobelRow);
             }
-            else
+            WorkspacePool::Lease magnitude = WorkspacePool::instance().acquire(3, cols, CV_16U);
+            WorkspacePool::Lease direction = WorkspacePool::instance().acquire(3, cols, CV_8U);
+
+            #pragma omp for schedule(runtime)
+            for (int strip = 0; strip < strips; ++strip)
             {
-                m_cannyEdges.at<uint8_t>(i, j) = 0; // Suppress
+                const int firstRow = strip * STRIP_ROWS;
+                const int lastRow = std::min(rows, firstRow + STRIP_ROWS);
+
+                for (size_t band = 0; band < bands.size(); ++band)
+                {
+                    gradients[band].reset(bands[band], firstRow);
+                }
+                int nextCombined = std::max(0, firstRow - 1);
+                for (int row = firstRow; row < lastRow; ++row)
+                {
+                    // Every band streams its own gradient, they are merged row by row before the suppression
+                    for (; nextCombined <= std::min(rows - 1, row + 1); ++nextCombined)
+                    {
+                        for (auto& gradient : gradients)
+                        {
+                            gradient.advanceTo(nextCombined);
+                        }
+                        combineBandRows(gradients, nextCombined, combination, weights,
+                                        magnitude.mat().ptr<uint16_t>(nextCombined % 3),
+                                        direction.mat().ptr<uint8_t>(nextCombined % 3), cols);
+                    }
+
+                    uint8_t* edges = m_cannyEdges.ptr<uint8_t>(row);
+                    if (row == 0 || row == rows - 1)
+                    {
+                        std::fill(edges, edges + cols, 0);
+                        continue;
+                    }
+                    suppressRow(magnitude.mat().ptr<uint16_t>((row - 1) % 3), magnitude.mat().ptr<uint16_t>(row % 3),
+                                magnitude.mat().ptr<uint16_t>((row + 1) % 3), direction.mat().ptr<uint8_t>(row % 3),
+                                edges, cols);
+                }
             }
+            gradients.clear();
         }
+    });
+}
+
+void EdgeDetection::selectThresholds()
+{
+    if (m_thresholdMode == ThresholdMode::Fixed)
+    {
+        m_thresholds = {m_lowThreshold, m_highThreshold};
+        return;
     }
 
-    // Handle borders separately
-    m_cannyEdges.row(0).setTo(0);
-    m_cannyEdges.row(rows - 1).setTo(0);
-    m_cannyEdges.col(0).setTo(0);
-    m_cannyEdges.col(cols - 1).setTo(0);
+    auto start_time = std::chrono::steady_clock::now();
+    const AutoThreshold::Histogram histogram = AutoThreshold::histogram(m_cannyEdges, AutoThreshold::SAMPLE_ROW_STEP);
+    m_thresholds = m_thresholdMode == ThresholdMode::Otsu ? AutoThreshold::otsu(histogram)
+                                                          : AutoThreshold::percentile(histogram);
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] selectThresholds (" << m_thresholds.low << ", " << m_thresholds.high
+                  << "): " << duration.count() << " seconds\n";
+    }
+    m_stageTimes.thresholds = duration.count();
+}
+
+void EdgeDetection::applyLinkingAndHysteresis()
+{
+    selectThresholds();
+
+    auto start_time = std::chrono::steady_clock::now();
+    Hysteresis::hysteresis(m_cannyEdges, m_cannyEdges, m_thresholds.low, m_thresholds.high);
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] apllyLinkingAndHysteresis: " << duration.count() << " seconds\n";
+    }
+    m_stageTimes.hysteresis = duration.count();
+}
+
+void EdgeDetection::setPipelineMode(PipelineMode mode)
+{
+    m_pipelineMode = mode;
+}
+
+void EdgeDetection::setSimdLevel(SobelKernels::SimdLevel level)
+{
+    m_simdLevel = std::min(level, SobelKernels::detectSimdLevel());
+}
+
+void EdgeDetection::setPrecision(Precision precision)
+{
+    m_precision = precision;
+}
+
+void EdgeDetection::setGradientNorm(SobelKernels::GradientNorm norm)
+{
+    m_gradientNorm = norm;
+}
+
+void EdgeDetection::setThreadAffinity(ThreadAffinity affinity)
+{
+    m_threadAffinity = affinity;
+}
+
+void EdgeDetection::setSuppressionCache(SuppressionCache* cache)
+{
+    m_suppressionCache = cache;
+}
+
+void EdgeDetection::setThresholdMode(ThresholdMode mode)
+{
+    m_thresholdMode = mode;
+}
+
+AutoThreshold::Thresholds EdgeDetection::getThresholds() const
+{
+    return m_thresholds;
+}
+
+const StageTimes& EdgeDetection::getStageTimes() const
+{
+    return m_stageTimes;
+}
+
+void EdgeDetection::setTimers(bool enabled)
+{
+    m_printTimers = enabled;
+}
 
-    m_imageFileOperations->saveImage(outputImage + "maxsupress.png", m_cannyEdges);
+void EdgeDetection::setDebugOutput(const std::string& outputDirectory)
+{
+    m_debugOutput = outputDirectory;
 }
 
-void EdgeDetection::checkContours(
-    cv::Mat& strongEdges, const cv::Mat& weakEdges, int row, int col, int prevRow, int prevCol)
+void EdgeDetection::saveDebugImage(const std::string& name, const cv::Mat& image)
 {
-    // Return if the bridge is completed
-    if (strongEdges.at<bool>(row, col))
+    if (!m_debugOutput.empty())
     {
-        return;
+        m_imageFileOperations->saveImage(m_debugOutput + name, image);
     }
+}
+
+SuppressionCache::Key EdgeDetection::suppressionKey(const cv::Mat& image) const
+{
+    SuppressionCache::Key key;
+    key.imageHash = SuppressionCache::hashImage(image);
+    key.rows = image.rows;
+    key.cols = image.cols;
+    key.sigma = m_sigma;
+    key.kernelSize = m_kernelSize;
+    // The pipeline mode and the SIMD level don't change the map
+    key.options = static_cast<uint32_t>(m_precision) | (static_cast<uint32_t>(m_gradientNorm) << 8);
+    return key;
+}
 
-    // If there is no weak contour clear the pixel
-    if (!(strongEdges.at<bool>(row, col) = weakEdges.at<bool>(row, col)))
+cv::Mat EdgeDetection::cannyEdgeDetection(const cv::Mat& image)
+{
+    cv::Mat edges;
+    cannyEdgeDetection(image, edges);
+    return edges;
+}
+
+void EdgeDetection::cannyEdgeDetection(const cv::Mat& image, cv::Mat& edges)
+{
+    if (image.empty() || image.type() != CV_8U)
     {
-        m_cannyEdges.at<uint8_t>(row, col) = 0;
-        return;
+        throw std::runtime_error("Canny edge detection expects a non empty 8-bit single channel image");
     }
+    const ThreadPlacement placement(m_threadAffinity);
+    m_originalImage = image;
+    edges.create(image.rows, image.cols, CV_8U);
+    m_cannyEdges = edges;
+    m_stageTimes = {};
 
-    // Now check all the connected pixels for any weak contours, avoid same pixel and previous pixel
-    for (int side_row = row - 1; side_row <= row + 1; ++side_row)
+    SuppressionCache::Key key;
+    bool cached = false;
+    if (m_suppressionCache != nullptr)
     {
-        for (int side_col = col - 1; side_col <= col + 1; ++side_col)
+        auto start_time = std::chrono::steady_clock::now();
+        key = suppressionKey(image);
+        cached = m_suppressionCache->find(key, m_cannyEdges);
+        auto end_time = std::chrono::steady_clock::now();
+        std::chrono::duration<double> duration = end_time - start_time;
+        if (m_printTimers)
         {
-            if ((side_col != prevCol && side_row != prevRow) && (side_col != col && side_row != row))
-            {
-                checkContours(strongEdges, weakEdges, side_row, side_col, row, col);
-            }
+            std::cout << "[TIMER] suppressionCache lookup (" << (cached ? "hit" : "miss") << "): " << duration.count()
+                      << " seconds\n";
         }
+        m_stageTimes.suppressionCache = duration.count();
     }
-}
 
-void EdgeDetection::applyLinkingAndHysteresis(const std::string& outputImage)
-{
-    const auto& rows = m_cannyEdges.rows;
-    const auto& cols = m_cannyEdges.cols;
+    if (cached)
+    {
+        saveDebugImage("maxsupress.png", m_cannyEdges);
+    }
+    else if (m_pipelineMode == PipelineMode::Staged)
+    {
+        WorkspacePool::Lease magnitude = WorkspacePool::instance().acquire(image.rows, image.cols, CV_16U);
+        WorkspacePool::Lease direction = WorkspacePool::instance().acquire(image.rows, image.cols, CV_8U);
+        m_magnitude = magnitude.mat();
+        m_direction = direction.mat();
 
-    // Initialize matrices for strong and weak edges using OpenCV matrices for better performance
-    cv::Mat strongEdges = cv::Mat::zeros(rows, cols, CV_32F);
-    cv::Mat weakEdges = cv::Mat::zeros(rows, cols, CV_32F);
+        applyGaussianBlur();
 
-    // Identify strong and weak edges
-    auto start_time = std::chrono::steady_clock::now();
-    #pragma omp parallel for collapse(2)
-    for (int row = 0; row < rows; ++row)
+        sobelOperator();
+
+        nonMaximumSuppression();
+
+        // The buffers go back to the pool with the leases
+        m_magnitude.release();
+        m_direction.release();
+    }
+    else
     {
-        for (int col = 0; col < cols; ++col)
+        auto start_time = std::chrono::steady_clock::now();
+        fusedBlurSobelSuppression();
+        auto end_time = std::chrono::steady_clock::now();
+        std::chrono::duration<double> duration = end_time - start_time;
+        if (m_printTimers)
         {
-            float pixelValue = m_cannyEdges.at<uint8_t>(row, col);
-            strongEdges.at<bool>(row, col) = (pixelValue >= m_highThreshold);
-            weakEdges.at<bool>(row, col) = (pixelValue >= m_lowThreshold);
+            std::cout << "[TIMER] fusedBlurSobelSuppression: " << duration.count() << " seconds\n";
         }
+        m_stageTimes.fusedSuppression = duration.count();
+
+        saveDebugImage("maxsupress.png", m_cannyEdges);
     }
-    auto end_time = std::chrono::steady_clock::now();
-    std::chrono::duration<double> duration = end_time - start_time;
-    std::cout << "[TIMER] apllyLinkingAndHysteresis: " << duration.count() << " seconds\n";
 
-    // Update edges matrix based on connected strength
-    #pragma omp parallel for collapse(2)
-    for (int row = 0; row < rows; ++row)
+    if (m_suppressionCache != nullptr && !cached)
     {
-        for (int col = 0; col < cols; ++col)
-        {
-            if (strongEdges.at<bool>(row, col))
-            {
-                continue;
-            }
+        auto start_time = std::chrono::steady_clock::now();
+        m_suppressionCache->insert(key, m_cannyEdges);
+        auto end_time = std::chrono::steady_clock::now();
+        std::chrono::duration<double> duration = end_time - start_time;
+        m_stageTimes.suppressionCache += duration.count();
+    }
+
+    applyLinkingAndHysteresis();
+    saveDebugImage("canny.png", m_cannyEdges);
+
+    // Don't keep references to the caller's images
+    m_originalImage.release();
+    m_cannyEdges.release();
+}
 
-            checkContours(strongEdges, weakEdges, row, col, row, col);
+void EdgeDetection::cannyEdgeDetection(const std::vector<cv::Mat>& bands,
+                                       cv::Mat& edges,
+                                       BandCombination combination,
+                                       const std::vector<float>& weights)
+{
+    if (bands.empty())
+    {
+        throw std::runtime_error("Multi-band edge detection needs at least one band");
+    }
+    for (const auto& band : bands)
+    {
+        if (band.empty() || band.type() != CV_8U || band.size() != bands.front().size())
+        {
+            throw std::runtime_error("Every band must be a non empty 8-bit single channel image of the same size");
         }
     }
-    m_imageFileOperations->saveImage(outputImage + "canny.png", m_cannyEdges);
+    if (!weights.empty() &&
+        (weights.size() != bands.size() ||
+         std::any_of(weights.begin(), weights.end(), [](float weight) { return weight < 0; })))
+    {
+        throw std::runtime_error("Band weights must be one non negative value per band");
+    }
+
+    const ThreadPlacement placement(m_threadAffinity);
+    edges.create(bands.front().rows, bands.front().cols, CV_8U);
+    m_cannyEdges = edges;
+    m_stageTimes = {};
+
+    auto start_time = std::chrono::steady_clock::now();
+    fusedMultiBandSuppression(bands, combination, weights);
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] fusedMultiBandSuppression (" << bands.size() << " bands): " << duration.count()
+                  << " seconds\n";
+    }
+    m_stageTimes.fusedSuppression = duration.count();
+    saveDebugImage("maxsupress.png", m_cannyEdges);
+
+    applyLinkingAndHysteresis();
+    saveDebugImage("canny.png", m_cannyEdges);
+
+    m_cannyEdges.release();
 }
 
-void EdgeDetection::cannyEdgeDetection(const std::string& inputImage, const std::string& outputImage)
+void EdgeDetection::previewEdgeDetection(const cv::Mat& image, cv::Mat& edges, int maxSide)
 {
-    m_imageFileOperations = std::make_shared<ImageFileOperations>();
+    if (image.empty() || image.type() != CV_8U)
+    {
+        throw std::runtime_error("Canny edge detection expects a non empty 8-bit single channel image");
+    }
+    if (maxSide < 1)
+    {
+        throw std::runtime_error("The preview side must be positive");
+    }
 
-    m_originalImage = m_imageFileOperations->loadImage(inputImage);
-    if (m_originalImage.empty())
+    const int factor = (std::max(image.rows, image.cols) + maxSide - 1) / maxSide;
+    if (factor == 1)
     {
-        throw std::runtime_error("Failed to load image: " + inputImage);
+        cannyEdgeDetection(image, edges);
+        return;
     }
-    m_cannyEdges = cv::Mat(m_originalImage.size(), m_originalImage.type());
-    m_magnitude = cv::Mat(m_originalImage.size(), CV_32F);
-    m_direction = cv::Mat(m_originalImage.size(), CV_32F);
 
-    applyGaussianBlur(outputImage);
+    auto start_time = std::chrono::steady_clock::now();
+    const int rows = (image.rows + factor - 1) / factor;
+    const int cols = (image.cols + factor - 1) / factor;
+    WorkspacePool::Lease reduced = WorkspacePool::instance().acquire(rows, cols, CV_8U);
+    boxDownsample(image, reduced.mat(), factor);
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    if (m_printTimers)
+    {
+        std::cout << "[TIMER] boxDownsample (1/" << factor << "): " << duration.count() << " seconds\n";
+    }
 
-    sobelOperator(outputImage);
+    cannyEdgeDetection(reduced.mat(), edges);
+    m_stageTimes.downsample = duration.count();
+}
 
-    nonMaximumSuppression(outputImage);
+void EdgeDetection::cannyEdgeDetection(const std::string& inputImage, const std::string& outputImage)
+{
+    MappedImage mapped;
+    cv::Mat image = m_imageFileOperations->openImage(inputImage, mapped);
+    if (image.empty())
+    {
+        throw std::runtime_error("Failed to load image: " + inputImage);
+    }
 
-    applyLinkingAndHysteresis(outputImage);
+    cv::Mat edges = cannyEdgeDetection(image);
+    if (!m_imageFileOperations->saveImage(outputImage + "canny.png", edges))
+    {
+        throw std::runtime_error("Failed to save image: " + outputImage + "canny.png");
+    }
 }
@@ -0,0 +1,321 @@
+/*
+ * LuckyAlgorithmForSatellites - edgeMapCodec
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "edgeMapCodec.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace EdgeMapCodec
+{
+namespace
+{
+// Rows encoded by each task. Tokens never cross blocks, which costs a token per block at most
+constexpr int ROWS_PER_BLOCK = 256;
+
+// Zero runs shorter than this stay inside the literal run around them, a token for them and another one to restart
+// the literal would take as many bytes
+constexpr size_t MIN_ZERO_RUN = 3;
+
+constexpr char MAGIC[4] = {'E', 'D', 'G', 'M'};
+
+size_t rowStride(uint32_t cols)
+{
+    return (static_cast<size_t>(cols) + 7) / 8;
+}
+
+// Packs 8-bit pixels 8 per byte, the first pixel in the most significant bit. The padding bits are zero
+void packRow(const uint8_t* pixels, int cols, uint8_t* packed)
+{
+    int col = 0;
+    for (; col + 8 <= cols; col += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, pixels + col, sizeof(word));
+        // High bit of every non zero byte, then the eight high bits gathered in one byte, first pixel on top
+        const uint64_t low = 0x7F7F7F7F7F7F7F7FULL;
+        const uint64_t nonZero = (((word & low) + low) | word) & ~low;
+        *packed++ = static_cast<uint8_t>(((nonZero >> 7) * 0x8040201008040201ULL) >> 56);
+    }
+    if (col < cols)
+    {
+        uint8_t bits = 0;
+        for (int bit = 0; col < cols; ++col, ++bit)
+        {
+            bits |= static_cast<uint8_t>((pixels[col] != 0) << (7 - bit));
+        }
+        *packed = bits;
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Replaces the runs of zero bytes of a packed block by tokens
+void encodeZeroRuns(const uint8_t* packed, size_t size, std::vector<uint8_t>& out)
+{
+    size_t position = 0;
+    while (position < size)
+    {
+        size_t zeros = 0;
+        while (position + zeros < size && packed[position + zeros] == 0)
+        {
+            zeros++;
+        }
+        if (zeros > 0)
+        {
+            putVarint(out, zeros << 1);
+            position += zeros;
+            continue;
+        }
+
+        // The literal run ends where a run of zeros long enough for its own token starts
+        size_t end = position;
+        while (end < size)
+        {
+            if (packed[end] != 0)
+            {
+                end++;
+                continue;
+            }
+            size_t run = 0;
+            while (end + run < size && packed[end + run] == 0 && run < MIN_ZERO_RUN)
+            {
+                run++;
+            }
+            if (run >= MIN_ZERO_RUN || end + run == size)
+            {
+                break;
+            }
+            end += run;
+        }
+        putVarint(out, ((end - position) << 1) | 1);
+        out.insert(out.end(), packed + position, packed + end);
+        position = end;
+    }
+}
+
+uint64_t getVarint(const uint8_t*& data, const uint8_t* end)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (data == end)
+        {
+            throw std::runtime_error("Truncated edge map token");
+        }
+        const uint8_t byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed edge map token");
+}
+
+// Unpacks rows 8 pixels at a time, the eight output bytes of every packed byte come from a table
+void unpackRow(const uint8_t* packed, int cols, uint8_t* pixels)
+{
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> bytes{};
+        for (int bits = 0; bits < 256; ++bits)
+        {
+            uint8_t expanded[8];
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                expanded[bit] = ((bits >> (7 - bit)) & 1) ? 255 : 0;
+            }
+            std::memcpy(&bytes[bits], expanded, sizeof(expanded));
+        }
+        return bytes;
+    }();
+
+    int col = 0;
+    for (; col + 8 <= cols; col += 8)
+    {
+        std::memcpy(pixels + col, &table[*packed++], sizeof(uint64_t));
+    }
+    for (int bit = 0; col < cols; ++col, ++bit)
+    {
+        pixels[col] = ((*packed >> (7 - bit)) & 1) ? 255 : 0;
+    }
+}
+
+template <typename T>
+void putLittleEndian(uint8_t* out, T value)
+{
+    for (size_t byte = 0; byte < sizeof(T); ++byte)
+    {
+        out[byte] = static_cast<uint8_t>(value >> (8 * byte));
+    }
+}
+
+template <typename T>
+T getLittleEndian(const uint8_t* in)
+{
+    T value = 0;
+    for (size_t byte = 0; byte < sizeof(T); ++byte)
+    {
+        value |= static_cast<T>(in[byte]) << (8 * byte);
+    }
+    return value;
+}
+} // namespace
+
+void encode(const cv::Mat& edges, std::vector<uint8_t>& buffer)
+{
+    if (edges.empty() || edges.type() != CV_8U)
+    {
+        throw std::runtime_error("The edge map must be a non empty 8-bit single channel image");
+    }
+    const size_t stride = rowStride(edges.cols);
+    const int blocks = (edges.rows + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+
+    std::vector<uint8_t> packed(stride * edges.rows);
+    std::vector<std::vector<uint8_t>> encoded(blocks);
+    #pragma omp parallel for schedule(dynamic)
+    for (int block = 0; block < blocks; ++block)
+    {
+        const int firstRow = block * ROWS_PER_BLOCK;
+        const int lastRow = std::min(edges.rows, firstRow + ROWS_PER_BLOCK);
+        for (int row = firstRow; row < lastRow; ++row)
+        {
+            packRow(edges.ptr<uint8_t>(row), edges.cols, &packed[row * stride]);
+        }
+        encodeZeroRuns(&packed[firstRow * stride], (lastRow - firstRow) * stride, encoded[block]);
+    }
+
+    size_t zeroRunsBytes = 0;
+    for (const auto& block : encoded)
+    {
+        zeroRunsBytes += block.size();
+    }
+    const uint8_t encoding = zeroRunsBytes < packed.size() ? ENCODING_ZERO_RUNS : ENCODING_PACKED;
+    const size_t payloadBytes = encoding == ENCODING_ZERO_RUNS ? zeroRunsBytes : packed.size();
+
+    buffer.resize(HEADER_BYTES + payloadBytes);
+    std::memcpy(buffer.data(), MAGIC, sizeof(MAGIC));
+    buffer[4] = VERSION;
+    buffer[5] = encoding;
+    putLittleEndian<uint16_t>(&buffer[6], 0);
+    putLittleEndian<uint32_t>(&buffer[8], edges.cols);
+    putLittleEndian<uint32_t>(&buffer[12], edges.rows);
+    putLittleEndian<uint64_t>(&buffer[16], payloadBytes);
+
+    uint8_t* payload = buffer.data() + HEADER_BYTES;
+    if (encoding == ENCODING_PACKED)
+    {
+        std::memcpy(payload, packed.data(), packed.size());
+        return;
+    }
+    for (const auto& block : encoded)
+    {
+        std::memcpy(payload, block.data(), block.size());
+        payload += block.size();
+    }
+}
+
+Header readHeader(const uint8_t* data, size_t size)
+{
+    if (size < HEADER_BYTES || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        throw std::runtime_error("Not an edge map");
+    }
+    if (data[4] != VERSION)
+    {
+        throw std::runtime_error("Unsupported edge map version: " + std::to_string(data[4]));
+    }
+
+    Header header;
+    header.encoding = data[5];
+    header.cols = getLittleEndian<uint32_t>(data + 8);
+    header.rows = getLittleEndian<uint32_t>(data + 12);
+    header.payloadBytes = getLittleEndian<uint64_t>(data + 16);
+    if (header.encoding != ENCODING_PACKED && header.encoding != ENCODING_ZERO_RUNS)
+    {
+        throw std::runtime_error("Unsupported edge map encoding: " + std::to_string(header.encoding));
+    }
+    if (header.cols == 0 || header.rows == 0 || header.cols > INT32_MAX || header.rows > INT32_MAX)
+    {
+        throw std::runtime_error("Invalid edge map size");
+    }
+    return header;
+}
+
+void decode(const uint8_t* data, size_t size, cv::Mat& edges)
+{
+    const Header header = readHeader(data, size);
+    if (size - HEADER_BYTES < header.payloadBytes)
+    {
+        throw std::runtime_error("Truncated edge map payload");
+    }
+    const size_t stride = rowStride(header.cols);
+    const uint8_t* payload = data + HEADER_BYTES;
+    const uint8_t* payloadEnd = payload + header.payloadBytes;
+
+    std::vector<uint8_t> packed;
+    if (header.encoding == ENCODING_PACKED)
+    {
+        if (header.payloadBytes != stride * header.rows)
+        {
+            throw std::runtime_error("Packed edge map of the wrong size");
+        }
+        packed.assign(payload, payloadEnd);
+    }
+    else
+    {
+        packed.reserve(stride * header.rows);
+        while (payload < payloadEnd)
+        {
+            const uint64_t token = getVarint(payload, payloadEnd);
+            const uint64_t count = token >> 1;
+            if (count > stride * header.rows - packed.size() || ((token & 1) && count > uint64_t(payloadEnd - payload)))
+            {
+                throw std::runtime_error("Edge map token past the end of the image");
+            }
+            if (token & 1)
+            {
+                packed.insert(packed.end(), payload, payload + count);
+                payload += count;
+            }
+            else
+            {
+                packed.resize(packed.size() + count, 0);
+            }
+        }
+        if (packed.size() != stride * header.rows)
+        {
+            throw std::runtime_error("Edge map tokens don't cover the image");
+        }
+    }
+
+    edges.create(static_cast<int>(header.rows), static_cast<int>(header.cols), CV_8U);
+    #pragma omp parallel for
+    for (int row = 0; row < edges.rows; ++row)
+    {
+        unpackRow(&packed[row * stride], edges.cols, edges.ptr<uint8_t>(row));
+    }
+}
+} // namespace EdgeMapCodec
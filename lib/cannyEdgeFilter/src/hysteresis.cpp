@@ -0,0 +1,200 @@
+/*
+ * LuckyAlgorithmForSatellites - hysteresis
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "hysteresis.hpp"
+#include "workspacePool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace Hysteresis
+{
+namespace
+{
+// Pixel states of the label map
+constexpr uint8_t NONE = 0;
+constexpr uint8_t WEAK = 1;
+constexpr uint8_t STRONG = 2;
+constexpr uint8_t EDGE = 3;
+
+// Marks pixel (row, col) as edge if it is an unvisited candidate, and queues it to visit its neighbors
+inline void visit(cv::Mat& labels, int row, int col, std::vector<cv::Point>& stack)
+{
+    uint8_t& label = labels.ptr<uint8_t>(row)[col];
+    if (label == WEAK || label == STRONG)
+    {
+        label = EDGE;
+        stack.emplace_back(col, row);
+    }
+}
+
+// Flood fills, within rows [firstRow, lastRow), every candidate pixel connected to the queued ones. Iterative, so
+// long edge chains can not overflow the call stack
+void floodFill(cv::Mat& labels, int firstRow, int lastRow, std::vector<cv::Point>& stack)
+{
+    const int cols = labels.cols;
+    while (!stack.empty())
+    {
+        const cv::Point pixel = stack.back();
+        stack.pop_back();
+
+        for (int row = std::max(firstRow, pixel.y - 1); row <= std::min(lastRow - 1, pixel.y + 1); ++row)
+        {
+            for (int col = std::max(0, pixel.x - 1); col <= std::min(cols - 1, pixel.x + 1); ++col)
+            {
+                visit(labels, row, col, stack);
+            }
+        }
+    }
+}
+
+// Queues the candidate pixels of a boundary row that touch an edge pixel of the neighboring row of another strip
+void seedFromNeighbor(cv::Mat& labels, int row, const uint8_t* neighbor, std::vector<cv::Point>& stack)
+{
+    const int cols = labels.cols;
+    for (int col = 0; col < cols; ++col)
+    {
+        if (neighbor[col] == EDGE || (col > 0 && neighbor[col - 1] == EDGE) ||
+            (col < cols - 1 && neighbor[col + 1] == EDGE))
+        {
+            visit(labels, row, col, stack);
+        }
+    }
+}
+} // namespace
+
+void hysteresis(const cv::Mat& suppressed, cv::Mat& edges, float lowThreshold, float highThreshold, int stripRows)
+{
+    if (suppressed.type() != CV_8U)
+    {
+        throw std::runtime_error("Hysteresis expects an 8-bit single channel image");
+    }
+    if (stripRows < 1)
+    {
+        throw std::runtime_error("Hysteresis strips need at least one row");
+    }
+
+    const int rows = suppressed.rows;
+    const int cols = suppressed.cols;
+    const int strips = (rows + stripRows - 1) / stripRows;
+
+    // 1. Double threshold
+    WorkspacePool::Lease labelsLease = WorkspacePool::instance().acquire(rows, cols, CV_8U);
+    cv::Mat& labels = labelsLease.mat();
+    #pragma omp parallel for
+    for (int row = 0; row < rows; ++row)
+    {
+        const uint8_t* src = suppressed.ptr<uint8_t>(row);
+        uint8_t* dst = labels.ptr<uint8_t>(row);
+        for (int col = 0; col < cols; ++col)
+        {
+            dst[col] = src[col] >= highThreshold ? STRONG : (src[col] >= lowThreshold ? WEAK : NONE);
+        }
+    }
+
+    // First and last row of every strip as they were at the end of the previous round
+    WorkspacePool::Lease boundaries = WorkspacePool::instance().acquire(std::max(1, strips * 2), cols, CV_8U);
+    auto snapshotRow = [&](int strip, bool last) { return boundaries.mat().ptr<uint8_t>(strip * 2 + last); };
+
+    // 2. Flood fill every strip from its strong pixels, then propagate across strips until nothing changes
+    bool changed = true;
+    for (int round = 0; changed; ++round)
+    {
+        changed = false;
+
+        #pragma omp parallel
+        {
+            // Kept by every thread across calls. A strip never queues more pixels than it has, so reserving that much
+            // once makes every later job of the same width allocation free, whichever thread gets the longest edges.
+            // Only the pages a flood fill reaches are ever touched
+            static thread_local std::vector<cv::Point> stack;
+            stack.reserve(static_cast<size_t>(stripRows) * cols);
+
+            #pragma omp for schedule(dynamic) reduction(|| : changed)
+            for (int strip = 0; strip < strips; ++strip)
+            {
+                const int firstRow = strip * stripRows;
+                const int lastRow = std::min(rows, firstRow + stripRows);
+
+                if (round == 0)
+                {
+                    for (int row = firstRow; row < lastRow; ++row)
+                    {
+                        const uint8_t* label = labels.ptr<uint8_t>(row);
+                        for (int col = 0; col < cols; ++col)
+                        {
+                            if (label[col] == STRONG)
+                            {
+                                visit(labels, row, col, stack);
+                                floodFill(labels, firstRow, lastRow, stack);
+                            }
+                        }
+                    }
+                    changed = true;
+                }
+                else
+                {
+                    if (strip > 0)
+                    {
+                        seedFromNeighbor(labels, firstRow, snapshotRow(strip - 1, true), stack);
+                    }
+                    if (strip < strips - 1)
+                    {
+                        seedFromNeighbor(labels, lastRow - 1, snapshotRow(strip + 1, false), stack);
+                    }
+                    floodFill(labels, firstRow, lastRow, stack);
+
+                    // Only new edges on the boundary rows can reach other strips
+                    changed = changed ||
+                              !std::equal(snapshotRow(strip, false), snapshotRow(strip, false) + cols,
+                                          labels.ptr<uint8_t>(firstRow)) ||
+                              !std::equal(snapshotRow(strip, true), snapshotRow(strip, true) + cols,
+                                          labels.ptr<uint8_t>(lastRow - 1));
+                }
+            }
+
+            #pragma omp for
+            for (int strip = 0; strip < strips; ++strip)
+            {
+                const int firstRow = strip * stripRows;
+                const int lastRow = std::min(rows, firstRow + stripRows);
+                std::copy_n(labels.ptr<uint8_t>(firstRow), cols, snapshotRow(strip, false));
+                std::copy_n(labels.ptr<uint8_t>(lastRow - 1), cols, snapshotRow(strip, true));
+            }
+        }
+
+        // A single strip has no boundaries to propagate across
+        if (strips == 1)
+        {
+            break;
+        }
+    }
+
+    // 3. Binary edge map
+    edges.create(rows, cols, CV_8U);
+    #pragma omp parallel for
+    for (int row = 0; row < rows; ++row)
+    {
+        const uint8_t* label = labels.ptr<uint8_t>(row);
+        uint8_t* dst = edges.ptr<uint8_t>(row);
+        for (int col = 0; col < cols; ++col)
+        {
+            dst[col] = label[col] == EDGE ? 255 : 0;
+        }
+    }
+}
+} // namespace Hysteresis
@@ -15,6 +15,9 @@
  */
 
 #include "imageFileOperations.hpp"
+#include <opencv2/imgcodecs.hpp>
+#include <fstream>
+#include <stdexcept>
 
 bool ImageFileOperations::saveImage(const std::string& filename, const cv::Mat& image)
 {
@@ -25,3 +28,57 @@ cv::Mat ImageFileOperations::loadImage(const std::string& filename)
 {
     return cv::imread(filename, cv::IMREAD_GRAYSCALE);
 }
+
+cv::Mat ImageFileOperations::openImage(const std::string& filename, MappedImage& mapped, MappedImage::Access access)
+{
+    if (MappedImage::isMappable(filename))
+    {
+        try
+        {
+            mapped = MappedImage(filename, access);
+            return mapped.mat();
+        }
+        catch (const std::runtime_error&)
+        {
+            // Such as 16-bit PGM, left to OpenCV
+        }
+    }
+    return loadImage(filename);
+}
+
+bool ImageFileOperations::saveRawImage(const std::string& filename, const cv::Mat& image, size_t alignment)
+{
+    if (image.empty() || image.type() != CV_8U || alignment == 0)
+    {
+        return false;
+    }
+    const size_t offset = (MappedImage::RAW_HEADER_BYTES + alignment - 1) / alignment * alignment;
+    const size_t stride = (image.cols + alignment - 1) / alignment * alignment;
+
+    std::vector<char> header(offset, 0);
+    const uint32_t fields[] = {static_cast<uint32_t>(image.cols), static_cast<uint32_t>(image.rows),
+                               static_cast<uint32_t>(offset), static_cast<uint32_t>(stride)};
+    std::copy(MappedImage::RAW_MAGIC, MappedImage::RAW_MAGIC + sizeof(MappedImage::RAW_MAGIC), header.begin());
+    for (size_t field = 0; field < 4; ++field)
+    {
+        for (size_t byte = 0; byte < 4; ++byte)
+        {
+            header[4 + 4 * field + byte] = static_cast<char>(fields[field] >> (8 * byte));
+        }
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(header.data(), header.size());
+    const std::vector<char> padding(stride - image.cols, 0);
+    for (int row = 0; row < image.rows; ++row)
+    {
+        file.write(image.ptr<char>(row), image.cols);
+        file.write(padding.data(), padding.size());
+    }
+    return static_cast<bool>(file);
+}
+
+bool ImageFileOperations::encodeImage(const cv::Mat& image, std::vector<uchar>& buffer, const std::string& extension)
+{
+    return cv::imencode(extension, image, buffer);
+}
@@ -0,0 +1,264 @@
+/*
+ * LuckyAlgorithmForSatellites - mappedImage
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "mappedImage.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+uint32_t getLittleEndian32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// Skips whitespace and comments, then reads an unsigned decimal field of a PGM header
+size_t readPgmField(const uint8_t* data, size_t size, size_t& position)
+{
+    while (position < size && (std::isspace(data[position]) || data[position] == '#'))
+    {
+        if (data[position] == '#')
+        {
+            while (position < size && data[position] != '\n')
+            {
+                position++;
+            }
+        }
+        else
+        {
+            position++;
+        }
+    }
+
+    size_t value = 0;
+    const size_t start = position;
+    while (position < size && std::isdigit(data[position]) && value <= INT32_MAX)
+    {
+        value = value * 10 + (data[position++] - '0');
+    }
+    if (position == start || value > INT32_MAX)
+    {
+        throw std::runtime_error("Invalid PGM header");
+    }
+    return value;
+}
+
+// Reads exactly the given bytes at an offset, false if the file ends before
+bool readFully(int fd, uint8_t* buffer, size_t bytes, size_t offset)
+{
+    while (bytes > 0)
+    {
+        const ssize_t read = pread(fd, buffer, bytes, static_cast<off_t>(offset));
+        if (read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (read <= 0)
+        {
+            return false;
+        }
+        buffer += read;
+        bytes -= read;
+        offset += read;
+    }
+    return true;
+}
+} // namespace
+
+MappedImage::MappedImage(const std::string& filename, Access access)
+{
+    const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Can not open " + filename);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < 4)
+    {
+        close(fd);
+        throw std::runtime_error("Can not map " + filename);
+    }
+    const size_t fileSize = fileStat.st_size;
+
+    // The header is parsed from the mapping, or from the first bytes of the file when it is read
+    uint8_t header[READ_HEADER_BYTES];
+    const uint8_t* data = header;
+    size_t available = 0;
+    if (access == Access::Map)
+    {
+        m_mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_mapping == MAP_FAILED)
+        {
+            m_mapping = nullptr;
+            close(fd);
+            throw std::runtime_error("Can not map " + filename);
+        }
+        m_size = fileSize;
+        // Start reading the pixels in the background, the first pass over them will likely find them in memory
+        madvise(m_mapping, m_size, MADV_WILLNEED);
+        data = static_cast<const uint8_t*>(m_mapping);
+        available = m_size;
+    }
+    else if (!readFully(fd, header, std::min(fileSize, READ_HEADER_BYTES), 0))
+    {
+        close(fd);
+        throw std::runtime_error("Can not read " + filename);
+    }
+    else
+    {
+        available = std::min(fileSize, READ_HEADER_BYTES);
+    }
+
+    size_t rows = 0;
+    size_t cols = 0;
+    size_t offset = 0;
+    size_t stride = 0;
+    try
+    {
+        if (data[0] == 'P' && data[1] == '5')
+        {
+            size_t position = 2;
+            cols = readPgmField(data, available, position);
+            rows = readPgmField(data, available, position);
+            const size_t maxValue = readPgmField(data, available, position);
+            if (maxValue == 0 || maxValue > 255 || position >= available || !std::isspace(data[position]))
+            {
+                throw std::runtime_error("Only 8-bit binary PGM images are mapped");
+            }
+            offset = position + 1; // A single whitespace ends the header
+            stride = cols;
+        }
+        else if (std::memcmp(data, RAW_MAGIC, sizeof(RAW_MAGIC)) == 0 && available >= RAW_HEADER_BYTES)
+        {
+            cols = getLittleEndian32(data + 4);
+            rows = getLittleEndian32(data + 8);
+            offset = getLittleEndian32(data + 12);
+            stride = getLittleEndian32(data + 16);
+            if (stride < cols || offset < RAW_HEADER_BYTES || cols > INT32_MAX || rows > INT32_MAX)
+            {
+                throw std::runtime_error("Invalid raw image header");
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Not a binary PGM or raw image");
+        }
+
+        // The last row only needs its pixels, not the whole stride
+        if (rows == 0 || cols == 0 || offset > fileSize || fileSize - offset < cols ||
+            (fileSize - offset - cols) / stride < rows - 1)
+        {
+            throw std::runtime_error("Truncated image");
+        }
+
+        if (access == Access::Read)
+        {
+            // A file truncated since fstat() comes short here, instead of faulting on a page of a mapping
+            m_buffer = WorkspacePool::instance().acquire(static_cast<int>(rows), static_cast<int>(cols), CV_8U);
+            cv::Mat& pixels = m_buffer.mat();
+            bool complete = true;
+            if (stride == cols && pixels.isContinuous())
+            {
+                complete = readFully(fd, pixels.data, rows * cols, offset);
+            }
+            for (size_t row = 0; stride != cols && complete && row < rows; ++row)
+            {
+                complete = readFully(fd, pixels.ptr(static_cast<int>(row)), cols, offset + row * stride);
+            }
+            if (!complete)
+            {
+                throw std::runtime_error("Truncated image");
+            }
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        close(fd);
+        unmap();
+        throw std::runtime_error(filename + ": " + e.what());
+    }
+    close(fd);
+
+    if (access == Access::Read)
+    {
+        m_mat = m_buffer.mat();
+    }
+    else
+    {
+        m_mat = cv::Mat(static_cast<int>(rows), static_cast<int>(cols), CV_8U,
+                        const_cast<uint8_t*>(data + offset), stride);
+    }
+}
+
+MappedImage::MappedImage(MappedImage&& other) noexcept
+    : m_mapping(other.m_mapping)
+    , m_size(other.m_size)
+    , m_buffer(std::move(other.m_buffer))
+    , m_mat(std::move(other.m_mat))
+{
+    other.m_mapping = nullptr;
+    other.m_size = 0;
+    other.m_mat = cv::Mat();
+}
+
+MappedImage& MappedImage::operator=(MappedImage&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        m_mapping = other.m_mapping;
+        m_size = other.m_size;
+        m_buffer = std::move(other.m_buffer);
+        m_mat = std::move(other.m_mat);
+        other.m_mapping = nullptr;
+        other.m_size = 0;
+        other.m_mat = cv::Mat();
+    }
+    return *this;
+}
+
+MappedImage::~MappedImage()
+{
+    unmap();
+}
+
+bool MappedImage::isMappable(const std::string& filename)
+{
+    char magic[4] = {};
+    std::ifstream file(filename, std::ios::binary);
+    file.read(magic, sizeof(magic));
+    return file && ((magic[0] == 'P' && magic[1] == '5') || std::memcmp(magic, RAW_MAGIC, sizeof(RAW_MAGIC)) == 0);
+}
+
+void MappedImage::unmap()
+{
+    m_mat = cv::Mat();
+    m_buffer = WorkspacePool::Lease();
+    if (m_mapping != nullptr)
+    {
+        munmap(m_mapping, m_size);
+        m_mapping = nullptr;
+        m_size = 0;
+    }
+}
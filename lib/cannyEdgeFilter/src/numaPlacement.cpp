@@ -0,0 +1,178 @@
+/*
+ * LuckyAlgorithmForSatellites - numaPlacement
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "numaPlacement.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <omp.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+
+// Without OpenMP the pragmas below are ignored, the placement would be a silent no-op
+#ifndef _OPENMP
+#error "NumaPlacement needs OpenMP, build the cannyEdge library with OpenMP::OpenMP_CXX"
+#endif
+
+namespace NumaPlacement
+{
+namespace
+{
+// Parses the kernel CPU list format, "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<Node> readTopology()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        // Without the mask of the process every CPU the kernel knows about is taken as available
+        for (int cpu = 0; cpu < std::min(omp_get_num_procs(), CPU_SETSIZE); ++cpu)
+        {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            continue;
+        }
+        std::ifstream cpulist(entry.path() / "cpulist");
+        std::string list;
+        std::getline(cpulist, list);
+
+        Node node {std::stoi(name.substr(4)), {}};
+        for (int cpu : parseCpuList(list))
+        {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+            {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty())
+        {
+            nodes.push_back(std::move(node));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+
+    // No sysfs, or a mask outside of every node: a single node with every allowed CPU
+    if (nodes.empty())
+    {
+        Node node {0, {}};
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                node.cpus.push_back(cpu);
+            }
+        }
+        nodes.push_back(std::move(node));
+    }
+    return nodes;
+}
+} // namespace
+
+const std::vector<Node>& topology()
+{
+    static const std::vector<Node> nodes = readTopology();
+    return nodes;
+}
+
+void pinThreads(ThreadAffinity affinity, int threads)
+{
+    const std::vector<Node>& nodes = topology();
+
+    // Every job of a pinned detector places its threads, the flat CPU list is built once like the topology
+    static const std::vector<int> cpus = [&nodes]() {
+        std::vector<int> all;
+        for (const Node& node : nodes)
+        {
+            all.insert(all.end(), node.cpus.begin(), node.cpus.end());
+        }
+        return all;
+    }();
+
+    #pragma omp parallel num_threads(threads > 0 ? threads : omp_get_max_threads())
+    {
+        const int thread = omp_get_thread_num();
+        const int team = omp_get_num_threads();
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        switch (affinity)
+        {
+        case ThreadAffinity::None:
+            for (int cpu : cpus)
+            {
+                CPU_SET(cpu, &set);
+            }
+            break;
+        case ThreadAffinity::Node:
+            for (int cpu : nodes[static_cast<size_t>(thread) * nodes.size() / team].cpus)
+            {
+                CPU_SET(cpu, &set);
+            }
+            break;
+        case ThreadAffinity::Core:
+            CPU_SET(cpus[thread % cpus.size()], &set);
+            break;
+        }
+
+        // The placement only affects the speed, a thread the kernel refuses to move keeps running where it is
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+}
+
+void firstTouch(cv::Mat& mat)
+{
+    const size_t rowBytes = mat.cols * mat.elemSize();
+    #pragma omp parallel for schedule(static)
+    for (int row = 0; row < mat.rows; ++row)
+    {
+        std::memset(mat.ptr(row), 0, rowBytes);
+    }
+}
+} // namespace NumaPlacement
@@ -15,9 +15,13 @@
  */
 
 #include "satelliteImageWrapper.hpp"
+#include <algorithm>
+#include <cpl_string.h>
+#include <mutex>
 
 // SatelliteImageWrapper methods
 SatelliteImageWrapper::SatelliteImageWrapper(const std::string& filename)
+    : m_filename(filename)
 {
     GDALAllRegister();
     m_dataset = (GDALDataset*)GDALOpen(filename.c_str(), GA_ReadOnly);
@@ -34,20 +38,287 @@ SatelliteImageWrapper::~SatelliteImageWrapper()
 
 cv::Mat SatelliteImageWrapper::readBand(int bandNumber)
 {
+    auto band = m_dataset->GetRasterBand(bandNumber);
+    if (!band)
+    {
+        throw std::runtime_error("Invalid band: " + std::to_string(bandNumber));
+    }
+    return readScaled(band, cv::Rect(0, 0, band->GetXSize(), band->GetYSize()), bandRange(band));
+}
 
+cv::Mat SatelliteImageWrapper::readWindow(int bandNumber, const cv::Rect& window)
+{
     auto band = m_dataset->GetRasterBand(bandNumber);
-    int xSize = band->GetXSize();
-    int ySize = band->GetYSize();
-    cv::Mat image(ySize, xSize, CV_32FC1); // Float for GDAL compatibility
-    if (band->RasterIO(GF_Read, 0, 0, xSize, ySize, image.data, xSize, ySize, GDT_Float32, 0, 0) != CE_None)
+    if (!band)
+    {
+        throw std::runtime_error("Invalid band: " + std::to_string(bandNumber));
+    }
+    return readScaled(band, window, bandRange(band));
+}
+
+std::vector<cv::Mat> SatelliteImageWrapper::readBands(const std::vector<int>& bandNumbers)
+{
+    std::vector<cv::Mat> bands(bandNumbers.size());
+    std::mutex errorMutex;
+    std::string error;
+
+    #pragma omp parallel
+    {
+        // GDAL handles are not thread safe, every thread reads through its own
+        GDALDataset* dataset = (GDALDataset*)GDALOpen(m_filename.c_str(), GA_ReadOnly);
+
+        #pragma omp for schedule(dynamic)
+        for (size_t index = 0; index < bandNumbers.size(); ++index)
+        {
+            GDALRasterBand* band = dataset ? dataset->GetRasterBand(bandNumbers[index]) : nullptr;
+            try
+            {
+                if (!band)
+                {
+                    throw std::runtime_error("Invalid band: " + std::to_string(bandNumbers[index]));
+                }
+                bands[index] = readScaled(band, cv::Rect(0, 0, band->GetXSize(), band->GetYSize()), bandRange(band));
+            }
+            catch (const std::exception& exception)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (error.empty())
+                {
+                    error = exception.what();
+                }
+            }
+        }
+
+        if (dataset)
+        {
+            GDALClose(dataset);
+        }
+    }
+
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+    return bands;
+}
+
+void SatelliteImageWrapper::detectEdgesTiled(int bandNumber,
+                                             const std::string& outputFile,
+                                             float lowThreshold,
+                                             float highThreshold,
+                                             float sigma,
+                                             int tileSize,
+                                             int kernelSize)
+{
+    detectEdgesTiled(
+        std::vector<int> {bandNumber}, outputFile, lowThreshold, highThreshold, sigma, BandCombination::Max, {},
+        tileSize, kernelSize);
+}
+
+void SatelliteImageWrapper::detectEdgesTiled(const std::vector<int>& bandNumbers,
+                                             const std::string& outputFile,
+                                             float lowThreshold,
+                                             float highThreshold,
+                                             float sigma,
+                                             BandCombination combination,
+                                             const std::vector<float>& weights,
+                                             int tileSize,
+                                             int kernelSize)
+{
+    if (tileSize <= 0 || tileSize % 16 != 0)
+    {
+        throw std::runtime_error("Tile size must be a positive multiple of 16: " + std::to_string(tileSize));
+    }
+    // Checked before the threads start, every one of them builds its own detector
+    if (kernelSize != 3 && kernelSize != 5 && kernelSize != 7)
+    {
+        throw std::runtime_error("Unsupported kernel size: " + std::to_string(kernelSize));
+    }
+    if (bandNumbers.empty())
+    {
+        throw std::runtime_error("No band to process");
+    }
+
+    // Every band keeps its own scaling, computed once for the whole scene
+    std::vector<std::pair<double, double>> ranges;
+    for (int bandNumber : bandNumbers)
+    {
+        auto band = m_dataset->GetRasterBand(bandNumber);
+        if (!band)
+        {
+            throw std::runtime_error("Invalid band: " + std::to_string(bandNumber));
+        }
+        ranges.push_back(bandRange(band));
+    }
+
+    const int xSize = m_dataset->GetRasterBand(bandNumbers.front())->GetXSize();
+    const int ySize = m_dataset->GetRasterBand(bandNumbers.front())->GetYSize();
+
+    // Tiled output, one block per tile
+    GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    if (!driver)
+    {
+        throw std::runtime_error("GeoTIFF driver not available");
+    }
+    const std::string blockSize = std::to_string(tileSize);
+    char** options = nullptr;
+    options = CSLSetNameValue(options, "TILED", "YES");
+    options = CSLSetNameValue(options, "BLOCKXSIZE", blockSize.c_str());
+    options = CSLSetNameValue(options, "BLOCKYSIZE", blockSize.c_str());
+    options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+    GDALDataset* output = driver->Create(outputFile.c_str(), xSize, ySize, 1, GDT_Byte, options);
+    CSLDestroy(options);
+    if (!output)
+    {
+        throw std::runtime_error("Failed to create file: " + outputFile);
+    }
+
+    double geoTransform[6];
+    if (m_dataset->GetGeoTransform(geoTransform) == CE_None)
+    {
+        output->SetGeoTransform(geoTransform);
+    }
+    output->SetProjection(m_dataset->GetProjectionRef());
+    GDALRasterBand* outputBand = output->GetRasterBand(1);
+
+    const int tilesX = (xSize + tileSize - 1) / tileSize;
+    const int tilesY = (ySize + tileSize - 1) / tileSize;
+    std::mutex writeMutex;
+    std::string error;
+
+    #pragma omp parallel
+    {
+        // GDAL handles are not thread safe, every thread reads through its own
+        GDALDataset* dataset = (GDALDataset*)GDALOpen(m_filename.c_str(), GA_ReadOnly);
+        EdgeDetection edgeDetection(lowThreshold, highThreshold, sigma, kernelSize);
+        edgeDetection.setTimers(false); // A scene has thousands of tiles
+        std::vector<cv::Mat> images(bandNumbers.size());
+        cv::Mat edges;
+
+        #pragma omp for schedule(dynamic)
+        for (int tile = 0; tile < tilesX * tilesY; ++tile)
+        {
+            if (!dataset)
+            {
+                continue;
+            }
+            try
+            {
+                const int tileX = (tile % tilesX) * tileSize;
+                const int tileY = (tile / tilesX) * tileSize;
+                const cv::Rect inner(
+                    tileX, tileY, std::min(tileSize, xSize - tileX), std::min(tileSize, ySize - tileY));
+                const int x0 = std::max(0, inner.x - TILE_HALO);
+                const int y0 = std::max(0, inner.y - TILE_HALO);
+                const int x1 = std::min(xSize, inner.x + inner.width + TILE_HALO);
+                const int y1 = std::min(ySize, inner.y + inner.height + TILE_HALO);
+
+                for (size_t band = 0; band < bandNumbers.size(); ++band)
+                {
+                    images[band] = readScaled(
+                        dataset->GetRasterBand(bandNumbers[band]), cv::Rect(x0, y0, x1 - x0, y1 - y0), ranges[band]);
+                }
+                if (images.size() == 1)
+                {
+                    edgeDetection.cannyEdgeDetection(images.front(), edges);
+                }
+                else
+                {
+                    edgeDetection.cannyEdgeDetection(images, edges, combination, weights);
+                }
+
+                // Only the tile itself is written, the halo belongs to the neighbors
+                cv::Mat block = edges(cv::Rect(inner.x - x0, inner.y - y0, inner.width, inner.height)).clone();
+                std::lock_guard<std::mutex> lock(writeMutex);
+                if (outputBand->RasterIO(GF_Write,
+                                         inner.x,
+                                         inner.y,
+                                         inner.width,
+                                         inner.height,
+                                         block.data,
+                                         inner.width,
+                                         inner.height,
+                                         GDT_Byte,
+                                         0,
+                                         0) != CE_None)
+                {
+                    throw std::runtime_error("Failed to write tile " + std::to_string(tile) + " to " + outputFile);
+                }
+            }
+            catch (const std::exception& exception)
+            {
+                // Exceptions can't leave the parallel region, the first one is rethrown after it
+                std::lock_guard<std::mutex> lock(writeMutex);
+                if (error.empty())
+                {
+                    error = exception.what();
+                }
+            }
+        }
+
+        if (dataset)
+        {
+            GDALClose(dataset);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            error = "Failed to open file: " + m_filename;
+        }
+    }
+
+    GDALClose(output);
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+std::pair<double, double> SatelliteImageWrapper::bandRange(GDALRasterBand* band)
+{
+    int hasMinimum = FALSE;
+    int hasMaximum = FALSE;
+    double minimum = band->GetMinimum(&hasMinimum);
+    double maximum = band->GetMaximum(&hasMaximum);
+    if (!hasMinimum || !hasMaximum)
+    {
+        double minMax[2];
+        if (band->ComputeRasterMinMax(FALSE, minMax) != CE_None)
+        {
+            throw std::runtime_error("Failed to compute the range of band: " + std::to_string(band->GetBand()));
+        }
+        minimum = minMax[0];
+        maximum = minMax[1];
+    }
+    return {minimum, maximum};
+}
+
+cv::Mat SatelliteImageWrapper::readScaled(GDALRasterBand* band,
+                                          const cv::Rect& window,
+                                          const std::pair<double, double>& range)
+{
+    cv::Mat image(window.height, window.width, CV_32FC1); // Float for GDAL compatibility
+    if (band->RasterIO(GF_Read,
+                       window.x,
+                       window.y,
+                       window.width,
+                       window.height,
+                       image.data,
+                       window.width,
+                       window.height,
+                       GDT_Float32,
+                       0,
+                       0) != CE_None)
     {
-        throw std::runtime_error("Failed to read raster data from band: " + std::to_string(bandNumber));
+        throw std::runtime_error("Failed to read raster data from band: " + std::to_string(band->GetBand()));
     }
 
-    // Convert to 8-bit
-    image.convertTo(image, CV_8UC1, 255.0 / (band->GetMaximum() - band->GetMinimum()), -band->GetMinimum());
+    // Convert to 8-bit. The range of the whole band maps to 0-255, so every tile is scaled the same way
+    const double span = range.second > range.first ? range.second - range.first : 1.0;
+    cv::Mat scaled;
+    image.convertTo(scaled, CV_8UC1, 255.0 / span, -range.first * 255.0 / span);
 
-    return image;
+    return scaled;
 }
 
 bool SatelliteImageWrapper::isValid() const
@@ -0,0 +1,319 @@
+/*
+ * LuckyAlgorithmForSatellites - sobelKernels
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "sobelKernels.hpp"
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SOBEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace SobelKernels
+{
+namespace
+{
+// tan(22.5) and tan(67.5) in Q16, |gy| << 16 stays below 2^31 for 8-bit input
+constexpr int32_t TAN_22_5_Q16 = 27146;
+constexpr int32_t TAN_67_5_Q16 = 158218;
+constexpr int DIRECTION_SHIFT = 16;
+constexpr float MAGNITUDE_SCALE = 1 << MAGNITUDE_FRACTION_BITS;
+
+inline uint8_t directionSector(int32_t gx, int32_t gy)
+{
+    int32_t ax = std::abs(gx);
+    int32_t ay = std::abs(gy) << DIRECTION_SHIFT;
+    if (ay <= ax * TAN_22_5_Q16)
+    {
+        return DIRECTION_0;
+    }
+    if (ay >= ax * TAN_67_5_Q16)
+    {
+        return DIRECTION_90;
+    }
+    return ((gx ^ gy) >= 0) ? DIRECTION_45 : DIRECTION_135;
+}
+
+template <GradientNorm Norm>
+inline void sobelPixel(const uint8_t* above, const uint8_t* center, const uint8_t* below, uint16_t* magnitude,
+                       uint8_t* direction, int col)
+{
+    int32_t gx = (above[col + 1] - above[col - 1]) + 2 * (center[col + 1] - center[col - 1]) +
+                 (below[col + 1] - below[col - 1]);
+    int32_t gy =
+        (above[col - 1] + 2 * above[col] + above[col + 1]) - (below[col - 1] + 2 * below[col] + below[col + 1]);
+    if constexpr (Norm == GradientNorm::L1)
+    {
+        magnitude[col] = static_cast<uint16_t>((std::abs(gx) + std::abs(gy)) << MAGNITUDE_FRACTION_BITS);
+    }
+    else
+    {
+        magnitude[col] = static_cast<uint16_t>(std::sqrt(static_cast<float>(gx * gx + gy * gy)) * MAGNITUDE_SCALE);
+    }
+    direction[col] = directionSector(gx, gy);
+}
+
+template <GradientNorm Norm>
+void sobelRowScalar(const uint8_t* above, const uint8_t* center, const uint8_t* below, uint16_t* magnitude,
+                    uint8_t* direction, int cols)
+{
+    for (int col = 1; col < cols - 1; ++col)
+    {
+        sobelPixel<Norm>(above, center, below, magnitude, direction, col);
+    }
+}
+
+#ifdef SOBEL_X86
+__attribute__((target("sse4.1"))) inline __m128i load4(const uint8_t* src)
+{
+    int32_t value;
+    __builtin_memcpy(&value, src, sizeof(value));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(value));
+}
+
+template <GradientNorm Norm>
+__attribute__((target("sse4.1"))) void sobelRowSSE4(const uint8_t* above, const uint8_t* center,
+                                                     const uint8_t* below, uint16_t* magnitude, uint8_t* direction,
+                                                     int cols)
+{
+    const __m128i tan22 = _mm_set1_epi32(TAN_22_5_Q16);
+    const __m128i tan67 = _mm_set1_epi32(TAN_67_5_Q16);
+    int col = 1;
+    for (; col + 4 <= cols - 1; col += 4)
+    {
+        __m128i aL = load4(above + col - 1), aC = load4(above + col), aR = load4(above + col + 1);
+        __m128i cL = load4(center + col - 1), cR = load4(center + col + 1);
+        __m128i bL = load4(below + col - 1), bC = load4(below + col), bR = load4(below + col + 1);
+
+        __m128i gx = _mm_add_epi32(_mm_add_epi32(_mm_sub_epi32(aR, aL), _mm_sub_epi32(bR, bL)),
+                                   _mm_slli_epi32(_mm_sub_epi32(cR, cL), 1));
+        __m128i gy = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(aL, aR), _mm_slli_epi32(aC, 1)),
+                                   _mm_add_epi32(_mm_add_epi32(bL, bR), _mm_slli_epi32(bC, 1)));
+
+        __m128i ax = _mm_abs_epi32(gx);
+        __m128i scaled;
+        if constexpr (Norm == GradientNorm::L1)
+        {
+            scaled = _mm_slli_epi32(_mm_add_epi32(ax, _mm_abs_epi32(gy)), MAGNITUDE_FRACTION_BITS);
+        }
+        else
+        {
+            __m128i squared = _mm_add_epi32(_mm_mullo_epi32(gx, gx), _mm_mullo_epi32(gy, gy));
+            scaled = _mm_cvttps_epi32(_mm_mul_ps(_mm_sqrt_ps(_mm_cvtepi32_ps(squared)), _mm_set1_ps(MAGNITUDE_SCALE)));
+        }
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(magnitude + col), _mm_packus_epi32(scaled, scaled));
+
+        __m128i ay = _mm_slli_epi32(_mm_abs_epi32(gy), DIRECTION_SHIFT);
+        __m128i isHorizontal = _mm_xor_si128(_mm_cmpgt_epi32(ay, _mm_mullo_epi32(ax, tan22)), _mm_set1_epi32(-1));
+        __m128i isVertical = _mm_xor_si128(_mm_cmpgt_epi32(_mm_mullo_epi32(ax, tan67), ay), _mm_set1_epi32(-1));
+        __m128i sameSign = _mm_xor_si128(_mm_srai_epi32(_mm_xor_si128(gx, gy), 31), _mm_set1_epi32(-1));
+
+        // 3 + 2 * (-1) = 1 when gx and gy have the same sign
+        __m128i code = _mm_add_epi32(_mm_set1_epi32(DIRECTION_135), _mm_add_epi32(sameSign, sameSign));
+        code = _mm_blendv_epi8(code, _mm_set1_epi32(DIRECTION_90), isVertical);
+        code = _mm_blendv_epi8(code, _mm_set1_epi32(DIRECTION_0), isHorizontal);
+
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(code, code), _mm_setzero_si128());
+        int32_t codes = _mm_cvtsi128_si32(packed);
+        __builtin_memcpy(direction + col, &codes, sizeof(codes));
+    }
+    for (; col < cols - 1; ++col)
+    {
+        sobelPixel<Norm>(above, center, below, magnitude, direction, col);
+    }
+}
+
+__attribute__((target("avx2"))) inline __m256i load8(const uint8_t* src)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+}
+
+template <GradientNorm Norm>
+__attribute__((target("avx2"))) void sobelRowAVX2(const uint8_t* above, const uint8_t* center, const uint8_t* below,
+                                                   uint16_t* magnitude, uint8_t* direction, int cols)
+{
+    const __m256i tan22 = _mm256_set1_epi32(TAN_22_5_Q16);
+    const __m256i tan67 = _mm256_set1_epi32(TAN_67_5_Q16);
+    const __m256i allOnes = _mm256_set1_epi32(-1);
+    int col = 1;
+    for (; col + 8 <= cols - 1; col += 8)
+    {
+        __m256i aL = load8(above + col - 1), aC = load8(above + col), aR = load8(above + col + 1);
+        __m256i cL = load8(center + col - 1), cR = load8(center + col + 1);
+        __m256i bL = load8(below + col - 1), bC = load8(below + col), bR = load8(below + col + 1);
+
+        __m256i gx = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(aR, aL), _mm256_sub_epi32(bR, bL)),
+                                      _mm256_slli_epi32(_mm256_sub_epi32(cR, cL), 1));
+        __m256i gy = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(aL, aR), _mm256_slli_epi32(aC, 1)),
+                                      _mm256_add_epi32(_mm256_add_epi32(bL, bR), _mm256_slli_epi32(bC, 1)));
+
+        __m256i ax = _mm256_abs_epi32(gx);
+        __m256i scaled;
+        if constexpr (Norm == GradientNorm::L1)
+        {
+            scaled = _mm256_slli_epi32(_mm256_add_epi32(ax, _mm256_abs_epi32(gy)), MAGNITUDE_FRACTION_BITS);
+        }
+        else
+        {
+            __m256i squared = _mm256_add_epi32(_mm256_mullo_epi32(gx, gx), _mm256_mullo_epi32(gy, gy));
+            scaled = _mm256_cvttps_epi32(
+                _mm256_mul_ps(_mm256_sqrt_ps(_mm256_cvtepi32_ps(squared)), _mm256_set1_ps(MAGNITUDE_SCALE)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(magnitude + col),
+                         _mm_packus_epi32(_mm256_castsi256_si128(scaled), _mm256_extracti128_si256(scaled, 1)));
+
+        __m256i ay = _mm256_slli_epi32(_mm256_abs_epi32(gy), DIRECTION_SHIFT);
+        __m256i isHorizontal = _mm256_xor_si256(_mm256_cmpgt_epi32(ay, _mm256_mullo_epi32(ax, tan22)), allOnes);
+        __m256i isVertical = _mm256_xor_si256(_mm256_cmpgt_epi32(_mm256_mullo_epi32(ax, tan67), ay), allOnes);
+        __m256i sameSign = _mm256_xor_si256(_mm256_srai_epi32(_mm256_xor_si256(gx, gy), 31), allOnes);
+
+        __m256i code = _mm256_add_epi32(_mm256_set1_epi32(DIRECTION_135), _mm256_add_epi32(sameSign, sameSign));
+        code = _mm256_blendv_epi8(code, _mm256_set1_epi32(DIRECTION_90), isVertical);
+        code = _mm256_blendv_epi8(code, _mm256_set1_epi32(DIRECTION_0), isHorizontal);
+
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(code), _mm256_extracti128_si256(code, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(direction + col), _mm_packus_epi16(words, words));
+    }
+    for (; col < cols - 1; ++col)
+    {
+        sobelPixel<Norm>(above, center, below, magnitude, direction, col);
+    }
+}
+
+__attribute__((target("avx512f"))) inline __m512i load16(const uint8_t* src)
+{
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+
+template <GradientNorm Norm>
+__attribute__((target("avx512f"))) void sobelRowAVX512(const uint8_t* above, const uint8_t* center,
+                                                        const uint8_t* below, uint16_t* magnitude, uint8_t* direction,
+                                                        int cols)
+{
+    const __m512i tan22 = _mm512_set1_epi32(TAN_22_5_Q16);
+    const __m512i tan67 = _mm512_set1_epi32(TAN_67_5_Q16);
+    int col = 1;
+    for (; col + 16 <= cols - 1; col += 16)
+    {
+        __m512i aL = load16(above + col - 1), aC = load16(above + col), aR = load16(above + col + 1);
+        __m512i cL = load16(center + col - 1), cR = load16(center + col + 1);
+        __m512i bL = load16(below + col - 1), bC = load16(below + col), bR = load16(below + col + 1);
+
+        __m512i gx = _mm512_add_epi32(_mm512_add_epi32(_mm512_sub_epi32(aR, aL), _mm512_sub_epi32(bR, bL)),
+                                      _mm512_slli_epi32(_mm512_sub_epi32(cR, cL), 1));
+        __m512i gy = _mm512_sub_epi32(_mm512_add_epi32(_mm512_add_epi32(aL, aR), _mm512_slli_epi32(aC, 1)),
+                                      _mm512_add_epi32(_mm512_add_epi32(bL, bR), _mm512_slli_epi32(bC, 1)));
+
+        __m512i ax = _mm512_abs_epi32(gx);
+        __m512i scaled;
+        if constexpr (Norm == GradientNorm::L1)
+        {
+            scaled = _mm512_slli_epi32(_mm512_add_epi32(ax, _mm512_abs_epi32(gy)), MAGNITUDE_FRACTION_BITS);
+        }
+        else
+        {
+            __m512i squared = _mm512_add_epi32(_mm512_mullo_epi32(gx, gx), _mm512_mullo_epi32(gy, gy));
+            scaled = _mm512_cvttps_epi32(
+                _mm512_mul_ps(_mm512_sqrt_ps(_mm512_cvtepi32_ps(squared)), _mm512_set1_ps(MAGNITUDE_SCALE)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(magnitude + col), _mm512_cvtusepi32_epi16(scaled));
+
+        __m512i ay = _mm512_slli_epi32(_mm512_abs_epi32(gy), DIRECTION_SHIFT);
+        __mmask16 isHorizontal = _mm512_cmple_epi32_mask(ay, _mm512_mullo_epi32(ax, tan22));
+        __mmask16 isVertical = _mm512_cmpge_epi32_mask(ay, _mm512_mullo_epi32(ax, tan67));
+        __mmask16 sameSign = _mm512_cmpge_epi32_mask(_mm512_xor_si512(gx, gy), _mm512_setzero_si512());
+
+        __m512i code = _mm512_mask_blend_epi32(sameSign, _mm512_set1_epi32(DIRECTION_135),
+                                               _mm512_set1_epi32(DIRECTION_45));
+        code = _mm512_mask_blend_epi32(isVertical, code, _mm512_set1_epi32(DIRECTION_90));
+        code = _mm512_mask_blend_epi32(isHorizontal, code, _mm512_set1_epi32(DIRECTION_0));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(direction + col), _mm512_cvtepi32_epi8(code));
+    }
+    for (; col < cols - 1; ++col)
+    {
+        sobelPixel<Norm>(above, center, below, magnitude, direction, col);
+    }
+}
+#endif
+} // namespace
+
+SimdLevel detectSimdLevel()
+{
+    static const SimdLevel detected = [] {
+#ifdef SOBEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return SimdLevel::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return SimdLevel::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1"))
+        {
+            return SimdLevel::SSE4;
+        }
+#endif
+        return SimdLevel::Scalar;
+    }();
+    return detected;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE4:
+        return "SSE4";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::AVX512:
+        return "AVX512";
+    default:
+        return "Scalar";
+    }
+}
+
+SobelRowFn getSobelRow(SimdLevel level, GradientNorm norm)
+{
+    if (level > detectSimdLevel())
+    {
+        level = detectSimdLevel();
+    }
+    const bool l1 = norm == GradientNorm::L1;
+    switch (level)
+    {
+#ifdef SOBEL_X86
+    case SimdLevel::AVX512:
+        return l1 ? sobelRowAVX512<GradientNorm::L1> : sobelRowAVX512<GradientNorm::L2>;
+    case SimdLevel::AVX2:
+        return l1 ? sobelRowAVX2<GradientNorm::L1> : sobelRowAVX2<GradientNorm::L2>;
+    case SimdLevel::SSE4:
+        return l1 ? sobelRowSSE4<GradientNorm::L1> : sobelRowSSE4<GradientNorm::L2>;
+#endif
+    default:
+        return l1 ? sobelRowScalar<GradientNorm::L1> : sobelRowScalar<GradientNorm::L2>;
+    }
+}
+
+SobelRowFn getSobelRow()
+{
+    return getSobelRow(detectSimdLevel());
+}
+} // namespace SobelKernels
@@ -0,0 +1,153 @@
+/*
+ * LuckyAlgorithmForSatellites - suppressionCache
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "suppressionCache.hpp"
+#include "workspacePool.hpp"
+#include <cstring>
+
+namespace
+{
+constexpr uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+uint64_t mix(uint64_t hash, uint64_t value)
+{
+    hash = (hash ^ value) * HASH_MULTIPLIER;
+    return hash ^ (hash >> 29);
+}
+
+// Four independent lanes, so the multiplications of consecutive words overlap
+uint64_t hashRow(const uint8_t* pixels, size_t size, uint64_t seed)
+{
+    uint64_t lanes[4] = {seed, seed + 1, seed + 2, seed + 3};
+    size_t position = 0;
+    for (; position + 32 <= size; position += 32)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint64_t word;
+            std::memcpy(&word, pixels + position + 8 * lane, sizeof(word));
+            lanes[lane] = mix(lanes[lane], word);
+        }
+    }
+    uint64_t hash = mix(mix(mix(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+    for (; position < size; ++position)
+    {
+        hash = mix(hash, pixels[position]);
+    }
+    return mix(hash, size);
+}
+} // namespace
+
+bool SuppressionCache::Key::operator==(const Key& other) const
+{
+    return imageHash == other.imageHash && rows == other.rows && cols == other.cols && sigma == other.sigma &&
+           kernelSize == other.kernelSize && options == other.options;
+}
+
+SuppressionCache::SuppressionCache(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+SuppressionCache& SuppressionCache::instance()
+{
+    static SuppressionCache cache;
+    return cache;
+}
+
+uint64_t SuppressionCache::hashImage(const cv::Mat& image)
+{
+    const size_t rowBytes = image.cols * image.elemSize();
+    // Leased like the working buffers of the pipeline, every job hashes its image. 64-bit floats are the same size
+    WorkspacePool::Lease rowHashesLease = WorkspacePool::instance().acquire(1, image.rows, CV_64F);
+    uint64_t* rowHashes = rowHashesLease.mat().ptr<uint64_t>();
+    #pragma omp parallel for
+    for (int row = 0; row < image.rows; ++row)
+    {
+        rowHashes[row] = hashRow(image.ptr<uint8_t>(row), rowBytes, row);
+    }
+
+    uint64_t hash = mix(image.rows, image.cols);
+    for (int row = 0; row < image.rows; ++row)
+    {
+        hash = mix(hash, rowHashes[row]);
+    }
+    return hash;
+}
+
+bool SuppressionCache::find(const Key& key, cv::Mat& suppressed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->key == key)
+        {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            it->suppressed.copyTo(suppressed);
+            m_hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SuppressionCache::insert(const Key& key, const cv::Mat& suppressed)
+{
+    const size_t bytes = suppressed.total() * suppressed.elemSize();
+    if (bytes > m_capacity)
+    {
+        return;
+    }
+
+    // Copy outside the lock, lookups of other images go on meanwhile
+    Entry entry {key, suppressed.clone()};
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->key == key)
+        {
+            m_cachedBytes -= it->suppressed.total() * it->suppressed.elemSize();
+            m_entries.erase(it);
+            break;
+        }
+    }
+    while (m_cachedBytes + bytes > m_capacity)
+    {
+        m_cachedBytes -= m_entries.back().suppressed.total() * m_entries.back().suppressed.elemSize();
+        m_entries.pop_back();
+    }
+    m_entries.push_front(std::move(entry));
+    m_cachedBytes += bytes;
+}
+
+size_t SuppressionCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+size_t SuppressionCache::cachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cachedBytes;
+}
+
+void SuppressionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_cachedBytes = 0;
+}
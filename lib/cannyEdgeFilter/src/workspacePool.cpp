@@ -0,0 +1,121 @@
+/*
+ * LuckyAlgorithmForSatellites - workspacePool
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#include "workspacePool.hpp"
+#include "numaPlacement.hpp"
+
+WorkspacePool::Lease::Lease(WorkspacePool* pool, cv::Mat mat)
+    : m_pool(pool)
+    , m_mat(std::move(mat))
+{
+}
+
+WorkspacePool::Lease::Lease(Lease&& other) noexcept
+    : m_pool(other.m_pool)
+    , m_mat(std::move(other.m_mat))
+{
+    other.m_pool = nullptr;
+}
+
+WorkspacePool::Lease& WorkspacePool::Lease::operator=(Lease&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_pool != nullptr)
+        {
+            m_pool->release(m_mat);
+        }
+        m_pool = other.m_pool;
+        m_mat = std::move(other.m_mat);
+        other.m_pool = nullptr;
+    }
+    return *this;
+}
+
+WorkspacePool::Lease::~Lease()
+{
+    if (m_pool != nullptr)
+    {
+        m_pool->release(m_mat);
+    }
+}
+
+WorkspacePool::WorkspacePool(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+WorkspacePool& WorkspacePool::instance()
+{
+    static WorkspacePool pool;
+    return pool;
+}
+
+WorkspacePool::Lease WorkspacePool::acquire(int rows, int cols, int type)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_free.find(Key(rows, cols, type));
+        if (it != m_free.end() && !it->second.empty())
+        {
+            cv::Mat mat = std::move(it->second.back());
+            it->second.pop_back();
+            m_cachedBytes -= mat.total() * mat.elemSize();
+            return Lease(this, std::move(mat));
+        }
+    }
+
+    // Allocate outside the lock, other threads may keep reusing buffers meanwhile
+    m_allocations++;
+    cv::Mat mat(rows, cols, type);
+    NumaPlacement::firstTouch(mat);
+    return Lease(this, std::move(mat));
+}
+
+size_t WorkspacePool::allocations() const
+{
+    return m_allocations;
+}
+
+size_t WorkspacePool::cachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cachedBytes;
+}
+
+void WorkspacePool::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.clear();
+    m_cachedBytes = 0;
+}
+
+void WorkspacePool::release(cv::Mat& mat)
+{
+    if (mat.empty())
+    {
+        return;
+    }
+
+    const size_t bytes = mat.total() * mat.elemSize();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cachedBytes + bytes <= m_capacity)
+    {
+        m_cachedBytes += bytes;
+        m_free[Key(mat.rows, mat.cols, mat.type())].push_back(std::move(mat));
+    }
+    mat.release();
+}
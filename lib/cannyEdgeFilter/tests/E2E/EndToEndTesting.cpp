@@ -14,55 +14,96 @@
  * all copies or substantial portions of the Software.
  */
 
-#include "SatelliteImageWrapper.hpp"
-#include "ImageFileOperations.hpp"
-#include "CannyEdgeFilter.hpp"
-#include <opencv2/highgui/highgui.hpp>
+#include "cannyOracle.hpp"
+#include "imageFileOperations.hpp"
+#include "satelliteImageWrapper.hpp"
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 
-void runTests(){
-    SatelliteImageWrapper imageWrapper("../../tests/sobelTest.jpg");
-    if (!imageWrapper.isValid()) {
-        std::cerr << "Failed to load image" << std::endl;
-        return;
-    }
-
-    cv::Mat image = imageWrapper.readBand(1);
-    if (image.empty()) {
-        std::cerr << "Failed to read band 1 from image" << std::endl;
-        return;
-    }
+// Correctness oracle: runs every accelerated variant of the pipeline next to the golden reference, over the synthetic
+// corpus and the images given as arguments, and reports the differing pixels and the PSNR of each one. Exits with an
+// error when a variant that must be exact differs.
+//
+// Usage: e2e_cannyEdge [image...]
 
-    EdgeDetection edgeDetection;
+namespace
+{
+constexpr int TILE_SIZE = 256; // Small tiles, so even the test images are split in several of them
 
-    // Applying Gaussian Blur
-    cv::Mat blurred(image.size(), image.type());
-    edgeDetection.applyGaussianBlur();
-
-    // Calculating the gradient magnitude and direction
-    cv::Mat magnitude(image.size(), CV_32F), direction(image.size(), CV_32F);
-    edgeDetection.sobelOperator(image, magnitude, direction);
+bool report(const std::string& image, const std::string& variant, const CannyOracle::Comparison& comparison,
+            bool exact)
+{
+    const bool failed = exact && comparison.differentPixels != 0;
+    std::printf("%-24s %-22s %10d %10.2f %s\n", image.c_str(), variant.c_str(), comparison.differentPixels,
+                comparison.psnr, failed ? "FAILED" : (exact ? "exact" : "informative"));
+    return !failed;
+}
 
-    // Non-maximum suppression
-    cv::Mat nonMaxSupp(image.size(), CV_8UC1);
-    edgeDetection.nonMaximumSuppression(magnitude, direction, nonMaxSupp);
+// The tiled GeoTIFF path reads through GDAL, which scales the band on its own, so it is compared with the in-memory
+// pipeline over the same band. Tiles only see TILE_HALO pixels around them, so long weak chains may differ
+bool checkTiled(const std::string& path, const CannyOracle::Parameters& parameters)
+{
+    SatelliteImageWrapper wrapper(path);
+    if (!wrapper.isValid())
+    {
+        std::cerr << "GDAL can not open " << path << ", skipping the tiled variant" << std::endl;
+        return true;
+    }
+    const cv::Mat band = wrapper.readBand(1);
+    const std::string output = (std::filesystem::temp_directory_path() / "oracle_tiled.tif").string();
+    wrapper.detectEdgesTiled(1, output, parameters.lowThreshold, parameters.highThreshold, parameters.sigma,
+                             TILE_SIZE, parameters.kernelSize);
 
-    // Double threshold and edge tracking by hysteresis
-    cv::Mat edges(image.size(), CV_8UC1);
-    edgeDetection.applyLinkingAndHysteresis(nonMaxSupp, edges, 50, 150);
+    ImageFileOperations imageFileOperations;
+    const cv::Mat tiled = imageFileOperations.loadImage(output);
+    std::filesystem::remove(output);
+    return report(std::filesystem::path(path).filename().string(), "tiled GeoTIFF",
+                  CannyOracle::compare(CannyOracle::reference(band, parameters), tiled), false);
+}
+} // namespace
 
-    // Display results
-    cv::imshow("Original Image", image);
-    cv::imshow("Magnitude", magnitude);
-    cv::imshow("Direction", direction);
-    cv::waitKey(0);
+int main(int argc, char** argv)
+{
+    std::vector<std::pair<std::string, cv::Mat>> corpus = CannyOracle::syntheticCorpus();
+    ImageFileOperations imageFileOperations;
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        cv::Mat image = imageFileOperations.loadImage(argv[arg]);
+        if (image.empty())
+        {
+            std::cerr << "Failed to load image: " << argv[arg] << std::endl;
+            return 1;
+        }
+        corpus.emplace_back(std::filesystem::path(argv[arg]).filename().string(), image);
+    }
 
-    std::cout << "Tests passed" << std::endl;
-}
+    bool passed = true;
+    std::printf("%-24s %-22s %10s %10s\n", "image", "variant", "different", "PSNR (dB)");
+    for (int kernelSize : {3, 5, 7})
+    {
+        CannyOracle::Parameters parameters;
+        parameters.kernelSize = kernelSize;
+        std::printf("-- kernel size %d\n", kernelSize);
 
-int main() {
+        for (const auto& [name, image] : corpus)
+        {
+            const cv::Mat expected = CannyOracle::reference(image, parameters);
+            for (const CannyOracle::Variant& variant : CannyOracle::variants())
+            {
+                passed &= report(name, variant.name, CannyOracle::compare(expected, variant.run(image, parameters)),
+                                 variant.exact);
+            }
+        }
+    }
 
-    runTests();    
+    const CannyOracle::Parameters parameters;
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        passed &= checkTiled(argv[arg], parameters);
+    }
 
-    return 0;
+    std::cout << (passed ? "Every exact variant matches the reference" : "Some variants differ from the reference")
+              << std::endl;
+    return passed ? 0 : 1;
 }
@@ -0,0 +1,157 @@
+#include "cannyEdgeFilter.hpp"
+#include "suppressionCache.hpp"
+#include "workspacePool.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+
+// Every heap allocation of this binary goes through these, they are counted while a test asks for it. OpenCV
+// allocates the header of every new buffer with operator new as well, so new cv::Mat data is counted too. Replacing
+// the global allocator affects the whole program, so these tests have a binary of their own
+namespace {
+std::atomic<bool> countingAllocations{false};
+std::atomic<size_t> heapAllocations{0};
+
+// Counts the heap allocations of every thread while it is alive
+class AllocationCounter {
+public:
+  AllocationCounter() {
+    heapAllocations = 0;
+    countingAllocations = true;
+  }
+  ~AllocationCounter() { countingAllocations = false; }
+  size_t count() const { return heapAllocations; }
+};
+
+void* countedAllocation(std::size_t size, std::size_t alignment) {
+  if (countingAllocations) {
+    heapAllocations++;
+  }
+  size = size != 0 ? size : 1;
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  // aligned_alloc wants a multiple of the alignment
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* throwingAllocation(std::size_t size, std::size_t alignment) {
+  if (void* pointer = countedAllocation(size, alignment)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+} // namespace
+
+void* operator new(std::size_t size) { return throwingAllocation(size, 0); }
+void* operator new[](std::size_t size) { return throwingAllocation(size, 0); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAllocation(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAllocation(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return throwingAllocation(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return throwingAllocation(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return countedAllocation(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return countedAllocation(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+TEST(AllocationTests, CounterSeesEveryOperatorNew) {
+  struct alignas(64) Aligned {
+    char bytes[64];
+  };
+  AllocationCounter counter;
+  delete new int;
+  delete[] new int[4];
+  delete new (std::nothrow) int;
+  delete new Aligned;
+  delete[] new Aligned[2];
+  delete new (std::nothrow) Aligned;
+  EXPECT_EQ(counter.count(), 6u);
+}
+
+TEST(AllocationTests, SteadyStateJobsDontAllocate) {
+  cv::Mat image(96, 128, CV_8U);
+  for (int row = 0; row < image.rows; ++row) {
+    for (int col = 0; col < image.cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>((row * 7 + col * 13) % 256);
+    }
+  }
+
+  for (auto mode : {PipelineMode::Fused, PipelineMode::Staged}) {
+    cv::Mat edges;
+    cv::Mat preview;
+    cv::Mat bandEdges;
+    const std::vector<cv::Mat> bands {image, image};
+    {
+      // The first jobs warm the pool up
+      EdgeDetection warmUp(40.0, 80.0, 1.0);
+      warmUp.setPipelineMode(mode);
+      warmUp.cannyEdgeDetection(image, edges);
+      warmUp.previewEdgeDetection(image, preview, 50);
+      warmUp.cannyEdgeDetection(bands, bandEdges, BandCombination::WeightedSum);
+    }
+    const uchar* output = edges.data;
+    const size_t allocations = WorkspacePool::instance().allocations();
+
+    // Like the server, a fresh detector for every request
+    EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+    edgeDetection.setPipelineMode(mode);
+    {
+      AllocationCounter counter;
+      for (int job = 0; job < 3; ++job) {
+        edgeDetection.cannyEdgeDetection(image, edges);
+        edgeDetection.previewEdgeDetection(image, preview, 50);
+        edgeDetection.cannyEdgeDetection(bands, bandEdges, BandCombination::WeightedSum);
+      }
+      EXPECT_EQ(counter.count(), 0u);
+    }
+    EXPECT_EQ(WorkspacePool::instance().allocations(), allocations);
+    EXPECT_EQ(edges.data, output);
+  }
+}
+
+TEST(AllocationTests, SuppressionCacheHitsDontAllocate) {
+  cv::Mat image(64, 80, CV_8U);
+  for (int row = 0; row < image.rows; ++row) {
+    for (int col = 0; col < image.cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>((row * 11 + col * 5) % 256);
+    }
+  }
+
+  SuppressionCache cache;
+  cv::Mat edges;
+  {
+    // The miss stores a copy of the suppressed map, that one allocates
+    EdgeDetection warmUp(40.0, 80.0, 1.0);
+    warmUp.setSuppressionCache(&cache);
+    warmUp.cannyEdgeDetection(image, edges);
+  }
+
+  EdgeDetection edgeDetection(30.0, 90.0, 1.0);
+  edgeDetection.setSuppressionCache(&cache);
+  AllocationCounter counter;
+  for (int job = 0; job < 3; ++job) {
+    edgeDetection.cannyEdgeDetection(image, edges);
+  }
+  EXPECT_EQ(counter.count(), 0u);
+  EXPECT_EQ(cache.hits(), 3u);
+}
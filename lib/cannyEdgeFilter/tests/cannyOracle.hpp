@@ -0,0 +1,436 @@
+/*
+ * LuckyAlgorithmForSatellites - cannyEdgeFilter correctness oracle
+ * Copyright (C) 2024, Operating Systems II.
+ * Apr 24, 2024.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ */
+
+#ifndef _CANNY_ORACLE_HPP
+#define _CANNY_ORACLE_HPP
+
+#include "batchEdgeDetection.hpp"
+#include "cannyEdgeFilter.hpp"
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <omp.h>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Golden references and comparison helpers for the Canny pipeline.
+ *
+ * The reference is the staged pipeline with the scalar Sobel kernel, the plainest path of the library. Every
+ * accelerated variant must match it pixel by pixel. A textbook implementation in double precision, sharing no code
+ * with the library, is compared too: it can't match bit by bit (the library uses float blur and fixed point
+ * magnitudes) but its PSNR shows when a change drifts away from plain Canny.
+ */
+namespace CannyOracle
+{
+/**
+ * @brief Parameters every variant runs with.
+ */
+struct Parameters
+{
+    float lowThreshold = 40.0f;
+    float highThreshold = 80.0f;
+    float sigma = 1.0f;
+    int kernelSize = KERNEL_SIZE;
+};
+
+/**
+ * @brief A way of running the pipeline to compare with the reference.
+ */
+struct Variant
+{
+    std::string name;
+    std::function<cv::Mat(const cv::Mat&, const Parameters&)> run;
+    bool exact; ///< Whether it must match the reference pixel by pixel.
+};
+
+/**
+ * @brief Difference between two edge maps.
+ */
+struct Comparison
+{
+    int differentPixels = 0;
+    double psnr = std::numeric_limits<double>::infinity(); ///< In dB, infinite for identical maps.
+};
+
+/**
+ * @brief Compares two 8-bit images of the same size.
+ * @param expected The reference image.
+ * @param actual The image to check.
+ * @return The number of different pixels and the PSNR.
+ */
+inline Comparison compare(const cv::Mat& expected, const cv::Mat& actual)
+{
+    Comparison comparison;
+    if (expected.size() != actual.size() || expected.type() != actual.type())
+    {
+        comparison.differentPixels = static_cast<int>(expected.total());
+        comparison.psnr = 0;
+        return comparison;
+    }
+
+    double squaredError = 0;
+    for (int row = 0; row < expected.rows; ++row)
+    {
+        const uint8_t* a = expected.ptr<uint8_t>(row);
+        const uint8_t* b = actual.ptr<uint8_t>(row);
+        for (int col = 0; col < expected.cols; ++col)
+        {
+            const double difference = static_cast<double>(a[col]) - b[col];
+            comparison.differentPixels += difference != 0;
+            squaredError += difference * difference;
+        }
+    }
+    if (comparison.differentPixels > 0)
+    {
+        const double meanSquaredError = squaredError / expected.total();
+        comparison.psnr = 10 * std::log10(255.0 * 255.0 / meanSquaredError);
+    }
+    return comparison;
+}
+
+/**
+ * @brief Runs the golden reference: the staged pipeline with the scalar Sobel kernel.
+ * @param image 8-bit single channel image.
+ * @param parameters Thresholds, sigma and kernel size.
+ * @return The edge map.
+ */
+inline cv::Mat reference(const cv::Mat& image, const Parameters& parameters)
+{
+    EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold, parameters.sigma,
+                                parameters.kernelSize);
+    edgeDetection.setPipelineMode(PipelineMode::Staged);
+    edgeDetection.setSimdLevel(SobelKernels::SimdLevel::Scalar);
+    edgeDetection.setTimers(false);
+    return edgeDetection.cannyEdgeDetection(image);
+}
+
+/**
+ * @brief Canny as described in the textbooks, in double precision and without any of the library code.
+ *
+ * Zero padded Gaussian blur truncated to 8 bits, 3x3 Sobel, direction from atan2 quantized to four sectors,
+ * non-maximum suppression keeping ties, and a breadth first hysteresis from the strong pixels.
+ *
+ * @param image 8-bit single channel image.
+ * @param parameters Thresholds, sigma and kernel size.
+ * @return The edge map.
+ */
+inline cv::Mat textbookCanny(const cv::Mat& image, const Parameters& parameters)
+{
+    const int rows = image.rows;
+    const int cols = image.cols;
+    const int half = parameters.kernelSize / 2;
+
+    std::vector<double> kernel(parameters.kernelSize);
+    double kernelSum = 0;
+    for (int x = 0; x < parameters.kernelSize; ++x)
+    {
+        kernel[x] = std::exp(-0.5 * std::pow((x - half) / static_cast<double>(parameters.sigma), 2.0));
+        kernelSum += kernel[x];
+    }
+    for (double& weight : kernel)
+    {
+        weight /= kernelSum;
+    }
+
+    std::vector<uint8_t> blurred(static_cast<size_t>(rows) * cols);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int col = 0; col < cols; ++col)
+        {
+            double sum = 0;
+            for (int krow = -half; krow <= half; ++krow)
+            {
+                for (int kcol = -half; kcol <= half; ++kcol)
+                {
+                    if (row + krow >= 0 && row + krow < rows && col + kcol >= 0 && col + kcol < cols)
+                    {
+                        const double weight = kernel[krow + half] * kernel[kcol + half];
+                        sum += weight * image.at<uint8_t>(row + krow, col + kcol);
+                    }
+                }
+            }
+            blurred[row * cols + col] = static_cast<uint8_t>(sum);
+        }
+    }
+
+    auto pixel = [&](int row, int col) { return static_cast<int>(blurred[row * cols + col]); };
+    std::vector<double> magnitude(static_cast<size_t>(rows) * cols, 0);
+    std::vector<int> sector(static_cast<size_t>(rows) * cols, 0);
+    for (int row = 1; row < rows - 1; ++row)
+    {
+        for (int col = 1; col < cols - 1; ++col)
+        {
+            const int gx = (pixel(row - 1, col + 1) + 2 * pixel(row, col + 1) + pixel(row + 1, col + 1)) -
+                           (pixel(row - 1, col - 1) + 2 * pixel(row, col - 1) + pixel(row + 1, col - 1));
+            const int gy = (pixel(row - 1, col - 1) + 2 * pixel(row - 1, col) + pixel(row - 1, col + 1)) -
+                           (pixel(row + 1, col - 1) + 2 * pixel(row + 1, col) + pixel(row + 1, col + 1));
+            magnitude[row * cols + col] = std::sqrt(static_cast<double>(gx * gx + gy * gy));
+
+            double angle = std::atan2(gy, gx) * 180.0 / M_PI;
+            if (angle < 0)
+            {
+                angle += 180;
+            }
+            sector[row * cols + col] = angle < 22.5 || angle >= 157.5 ? 0
+                                       : angle < 67.5                    ? 45
+                                       : angle < 112.5                   ? 90
+                                                                         : 135;
+        }
+    }
+
+    // Rows grow downwards while the gradient angle grows upwards
+    cv::Mat strength(rows, cols, CV_8U, cv::Scalar(0));
+    for (int row = 1; row < rows - 1; ++row)
+    {
+        for (int col = 1; col < cols - 1; ++col)
+        {
+            int dRow = 0;
+            int dCol = 1;
+            switch (sector[row * cols + col])
+            {
+            case 45:
+                dRow = -1;
+                dCol = 1;
+                break;
+            case 90:
+                dRow = -1;
+                dCol = 0;
+                break;
+            case 135:
+                dRow = -1;
+                dCol = -1;
+                break;
+            }
+            const double center = magnitude[row * cols + col];
+            if (center >= magnitude[(row + dRow) * cols + col + dCol] &&
+                center >= magnitude[(row - dRow) * cols + col - dCol])
+            {
+                strength.at<uint8_t>(row, col) = static_cast<uint8_t>(std::min(std::floor(center), 255.0));
+            }
+        }
+    }
+
+    cv::Mat edges(rows, cols, CV_8U, cv::Scalar(0));
+    std::vector<std::pair<int, int>> queue;
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int col = 0; col < cols; ++col)
+        {
+            if (strength.at<uint8_t>(row, col) >= parameters.highThreshold)
+            {
+                edges.at<uint8_t>(row, col) = 255;
+                queue.emplace_back(row, col);
+            }
+        }
+    }
+    for (size_t next = 0; next < queue.size(); ++next)
+    {
+        const auto [row, col] = queue[next];
+        for (int neighborRow = std::max(0, row - 1); neighborRow <= std::min(rows - 1, row + 1); ++neighborRow)
+        {
+            for (int neighborCol = std::max(0, col - 1); neighborCol <= std::min(cols - 1, col + 1); ++neighborCol)
+            {
+                if (edges.at<uint8_t>(neighborRow, neighborCol) == 0 &&
+                    strength.at<uint8_t>(neighborRow, neighborCol) >= parameters.lowThreshold)
+                {
+                    edges.at<uint8_t>(neighborRow, neighborCol) = 255;
+                    queue.emplace_back(neighborRow, neighborCol);
+                }
+            }
+        }
+    }
+    return edges;
+}
+
+/**
+ * @brief Gets every accelerated way of running the pipeline on a single band image.
+ * @return The variants. The fixed point ones and the textbook one compute something slightly different, they are only
+ * reported.
+ */
+inline std::vector<Variant> variants()
+{
+    std::vector<Variant> variants;
+    for (SobelKernels::SimdLevel level : {SobelKernels::SimdLevel::SSE4, SobelKernels::SimdLevel::AVX2,
+                                          SobelKernels::SimdLevel::AVX512})
+    {
+        if (level > SobelKernels::detectSimdLevel())
+        {
+            continue;
+        }
+        variants.push_back({std::string("staged ") + SobelKernels::simdLevelName(level),
+                            [level](const cv::Mat& image, const Parameters& parameters) {
+                                EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                            parameters.sigma, parameters.kernelSize);
+                                edgeDetection.setPipelineMode(PipelineMode::Staged);
+                                edgeDetection.setSimdLevel(level);
+                                edgeDetection.setTimers(false);
+                                return edgeDetection.cannyEdgeDetection(image);
+                            },
+                            true});
+    }
+    variants.push_back({"fused scalar",
+                        [](const cv::Mat& image, const Parameters& parameters) {
+                            EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                        parameters.sigma, parameters.kernelSize);
+                            edgeDetection.setSimdLevel(SobelKernels::SimdLevel::Scalar);
+                            edgeDetection.setTimers(false);
+                            return edgeDetection.cannyEdgeDetection(image);
+                        },
+                        true});
+    variants.push_back({"fused",
+                        [](const cv::Mat& image, const Parameters& parameters) {
+                            EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                        parameters.sigma, parameters.kernelSize);
+                            edgeDetection.setTimers(false);
+                            return edgeDetection.cannyEdgeDetection(image);
+                        },
+                        true});
+    variants.push_back({"fused single thread",
+                        [](const cv::Mat& image, const Parameters& parameters) {
+                            EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                        parameters.sigma, parameters.kernelSize);
+                            edgeDetection.setTimers(false);
+                            const int threads = omp_get_max_threads();
+                            omp_set_num_threads(1);
+                            cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+                            omp_set_num_threads(threads);
+                            return edges;
+                        },
+                        true});
+    variants.push_back({"fused node affinity",
+                        [](const cv::Mat& image, const Parameters& parameters) {
+                            EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                        parameters.sigma, parameters.kernelSize);
+                            edgeDetection.setThreadAffinity(ThreadAffinity::Node);
+                            edgeDetection.setTimers(false);
+                            cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+                            NumaPlacement::pinThreads(ThreadAffinity::None);
+                            return edges;
+                        },
+                        true});
+    variants.push_back({"multi-band",
+                        [](const cv::Mat& image, const Parameters& parameters) {
+                            EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                        parameters.sigma, parameters.kernelSize);
+                            edgeDetection.setTimers(false);
+                            cv::Mat edges;
+                            edgeDetection.cannyEdgeDetection({image}, edges, BandCombination::Max);
+                            return edges;
+                        },
+                        true});
+    variants.push_back({"batch",
+                        [](const cv::Mat& image, const Parameters& parameters) {
+                            BatchEdgeDetection batch(parameters.lowThreshold, parameters.highThreshold,
+                                                     parameters.sigma, parameters.kernelSize);
+                            batch.setTimers(false);
+                            std::vector<cv::Mat> edges;
+                            batch.process({image, image}, edges);
+                            return edges[1];
+                        },
+                        true});
+    for (SobelKernels::GradientNorm norm : {SobelKernels::GradientNorm::L2, SobelKernels::GradientNorm::L1})
+    {
+        variants.push_back({norm == SobelKernels::GradientNorm::L1 ? "fixed point L1" : "fixed point",
+                            [norm](const cv::Mat& image, const Parameters& parameters) {
+                                EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold,
+                                                            parameters.sigma, parameters.kernelSize);
+                                edgeDetection.setPrecision(Precision::FixedPoint);
+                                edgeDetection.setGradientNorm(norm);
+                                edgeDetection.setTimers(false);
+                                return edgeDetection.cannyEdgeDetection(image);
+                            },
+                            false});
+    }
+    variants.push_back({"textbook", textbookCanny, false});
+    return variants;
+}
+
+/**
+ * @brief Builds synthetic images covering the cases the optimized paths split on.
+ *
+ * Sizes that aren't multiples of the SIMD widths or of the strip heights, images narrower than the kernels, flat
+ * areas, noise, and long weak chains that cross many strips.
+ *
+ * @return Pairs of name and 8-bit image.
+ */
+inline std::vector<std::pair<std::string, cv::Mat>> syntheticCorpus()
+{
+    std::vector<std::pair<std::string, cv::Mat>> corpus;
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> noise(-25, 25);
+    auto clamp = [](int value) { return static_cast<uint8_t>(std::min(255, std::max(0, value))); };
+
+    cv::Mat blocks(301, 257, CV_8U);
+    for (int row = 0; row < blocks.rows; ++row)
+    {
+        for (int col = 0; col < blocks.cols; ++col)
+        {
+            blocks.at<uint8_t>(row, col) = clamp(((row / 37 + col / 29) % 3) * 90 + 20 + noise(generator));
+        }
+    }
+    corpus.emplace_back("noisy blocks 301x257", blocks);
+
+    cv::Mat rings(200, 333, CV_8U);
+    for (int row = 0; row < rings.rows; ++row)
+    {
+        for (int col = 0; col < rings.cols; ++col)
+        {
+            const double radius = std::hypot(row - 100.0, col - 160.0);
+            rings.at<uint8_t>(row, col) = clamp(static_cast<int>(127 + 100 * std::sin(radius / 6.0)));
+        }
+    }
+    corpus.emplace_back("rings 200x333", rings);
+
+    // A faint diagonal that only hysteresis can follow from one end to the other
+    cv::Mat chain(400, 90, CV_8U, cv::Scalar(100));
+    for (int row = 0; row < chain.rows; ++row)
+    {
+        const int col = 10 + (row * 70) / chain.rows;
+        chain.at<uint8_t>(row, col) = row < 5 ? 255 : 125;
+    }
+    corpus.emplace_back("weak chain 400x90", chain);
+
+    cv::Mat random(67, 45, CV_8U);
+    std::uniform_int_distribution<int> uniform(0, 255);
+    for (int row = 0; row < random.rows; ++row)
+    {
+        for (int col = 0; col < random.cols; ++col)
+        {
+            random.at<uint8_t>(row, col) = static_cast<uint8_t>(uniform(generator));
+        }
+    }
+    corpus.emplace_back("random 67x45", random);
+
+    cv::Mat narrow(64, 5, CV_8U);
+    for (int row = 0; row < narrow.rows; ++row)
+    {
+        for (int col = 0; col < narrow.cols; ++col)
+        {
+            narrow.at<uint8_t>(row, col) = static_cast<uint8_t>(row < 32 ? 30 : 220);
+        }
+    }
+    corpus.emplace_back("narrow 64x5", narrow);
+
+    corpus.emplace_back("flat 50x50", cv::Mat(50, 50, CV_8U, cv::Scalar(128)));
+    return corpus;
+}
+} // namespace CannyOracle
+
+#endif /* _CANNY_ORACLE_HPP */
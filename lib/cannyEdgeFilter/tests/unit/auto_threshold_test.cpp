@@ -0,0 +1,75 @@
+#include "autoThreshold.hpp"
+#include "cannyEdgeFilter.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+TEST(AutoThresholdTests, HistogramCountsEveryPixel) {
+  cv::Mat image(37, 53, CV_8U);
+  for (int row = 0; row < image.rows; ++row) {
+    for (int col = 0; col < image.cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>((row * 7 + col) % 5 == 0 ? 0 : (row + col) % 256);
+    }
+  }
+
+  AutoThreshold::Histogram expected {};
+  for (int row = 0; row < image.rows; ++row) {
+    for (int col = 0; col < image.cols; ++col) {
+      ++expected[image.at<uint8_t>(row, col)];
+    }
+  }
+  EXPECT_EQ(AutoThreshold::histogram(image), expected);
+}
+
+TEST(AutoThresholdTests, OtsuSplitsTwoPopulations) {
+  AutoThreshold::Histogram histogram {};
+  histogram[0] = 100000;
+  histogram[20] = 500;
+  histogram[25] = 500;
+  histogram[120] = 100;
+  histogram[130] = 100;
+
+  AutoThreshold::Thresholds thresholds = AutoThreshold::otsu(histogram);
+  EXPECT_GT(thresholds.high, 25);
+  EXPECT_LE(thresholds.high, 120);
+  EXPECT_FLOAT_EQ(thresholds.low, thresholds.high * AutoThreshold::DEFAULT_LOW_RATIO);
+}
+
+TEST(AutoThresholdTests, PercentileLeavesTheFractionBelow) {
+  AutoThreshold::Histogram histogram {};
+  for (int value = 1; value <= 100; ++value) {
+    histogram[value] = 10;
+  }
+
+  AutoThreshold::Thresholds thresholds = AutoThreshold::percentile(histogram, 0.8f);
+  EXPECT_FLOAT_EQ(thresholds.high, 81);
+  EXPECT_FLOAT_EQ(thresholds.low, 40.5f);
+}
+
+TEST(AutoThresholdTests, LowThresholdNeverAcceptsZeros) {
+  AutoThreshold::Histogram histogram {};
+  histogram[1] = 10;
+  histogram[2] = 10;
+
+  EXPECT_GE(AutoThreshold::otsu(histogram).low, 1);
+  EXPECT_GE(AutoThreshold::percentile(histogram, 0.0f).low, 1);
+  EXPECT_FLOAT_EQ(AutoThreshold::otsu(AutoThreshold::Histogram {}).high, 255);
+}
+
+TEST(AutoThresholdTests, EdgeDetectionUsesSelectedThresholds) {
+  cv::Mat image(128, 128, CV_8U);
+  std::mt19937 generator(3);
+  std::uniform_int_distribution<int> noise(-10, 10);
+  for (int row = 0; row < image.rows; ++row) {
+    for (int col = 0; col < image.cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>((col < 64 ? 60 : 180) + noise(generator));
+    }
+  }
+
+  EdgeDetection edgeDetection(1000.0, 2000.0, 1.0);
+  EXPECT_EQ(cv::countNonZero(edgeDetection.cannyEdgeDetection(image)), 0);
+
+  edgeDetection.setThresholdMode(ThresholdMode::Otsu);
+  cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+  EXPECT_GT(cv::countNonZero(edges), 0);
+  EXPECT_LT(edgeDetection.getThresholds().high, 255);
+}
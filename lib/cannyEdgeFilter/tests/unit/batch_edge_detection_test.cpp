@@ -0,0 +1,67 @@
+#include "batchEdgeDetection.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+cv::Mat testImage(int rows, int cols, unsigned seed) {
+  cv::Mat image(rows, cols, CV_8U);
+  std::mt19937 generator(seed);
+  std::uniform_int_distribution<int> noise(-20, 20);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      int base = ((row / 30 + col / 40) % 2) * 150 + 50;
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>(base + noise(generator));
+    }
+  }
+  return image;
+}
+} // namespace
+
+TEST(BatchEdgeDetectionTests, MatchesSingleImageDetection) {
+  std::vector<cv::Mat> images;
+  for (unsigned i = 0; i < 12; ++i) {
+    images.push_back(testImage(40 + 7 * i, 60 + 5 * i, i));
+  }
+  images.push_back(testImage(300, 280, 99));
+
+  BatchEdgeDetection batch(40.0, 80.0, 1.0);
+  batch.setSmallImagePixels(200 * 200);
+  std::vector<cv::Mat> edges;
+  BatchReport report = batch.process(images, edges);
+
+  ASSERT_EQ(edges.size(), images.size());
+  EXPECT_EQ(report.images, images.size());
+  EXPECT_GE(report.imagesPerSecond(), 0);
+  for (size_t i = 0; i < images.size(); ++i) {
+    EdgeDetection single(40.0, 80.0, 1.0);
+    single.setTimers(false);
+    EXPECT_EQ(cv::countNonZero(single.cannyEdgeDetection(images[i]) != edges[i]), 0) << "image " << i;
+  }
+}
+
+TEST(BatchEdgeDetectionTests, ReportsFirstFailingImage) {
+  std::vector<cv::Mat> images {testImage(50, 50, 1), cv::Mat(), testImage(50, 50, 2)};
+  BatchEdgeDetection batch(40.0, 80.0, 1.0);
+  std::vector<cv::Mat> edges;
+
+  EXPECT_THROW(batch.process(images, edges), std::runtime_error);
+  EXPECT_GT(cv::countNonZero(edges[0]), 0);
+}
+
+TEST(BatchEdgeDetectionTests, TimersCanBeTurnedOff) {
+  BatchEdgeDetection batch(40.0, 80.0, 1.0);
+  std::vector<cv::Mat> edges;
+
+  testing::internal::CaptureStdout();
+  batch.process({testImage(50, 50, 1)}, edges);
+  EXPECT_NE(testing::internal::GetCapturedStdout().find("[TIMER] Batch"), std::string::npos);
+
+  batch.setTimers(false);
+  testing::internal::CaptureStdout();
+  batch.process({testImage(50, 50, 1), testImage(300, 280, 2)}, edges);
+  EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+}
+
+TEST(BatchEdgeDetectionTests, RejectsUnsupportedKernelSize) {
+  EXPECT_THROW(BatchEdgeDetection(40.0, 80.0, 1.0, 4), std::runtime_error);
+}
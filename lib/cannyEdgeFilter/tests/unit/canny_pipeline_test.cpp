@@ -0,0 +1,145 @@
+#include "cannyEdgeFilter.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+// Noise over a few flat regions, so there are both strong edges and weak chains
+cv::Mat testImage(int rows, int cols) {
+  cv::Mat image(rows, cols, CV_8U);
+  std::mt19937 generator(5);
+  std::uniform_int_distribution<int> noise(-20, 20);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      int base = ((row / 40 + col / 50) % 2) * 150 + 50;
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>(base + noise(generator));
+    }
+  }
+  return image;
+}
+} // namespace
+
+TEST(CannyPipelineTests, FusedMatchesStaged) {
+  const cv::Mat image = testImage(203, 157);
+
+  EdgeDetection staged(40.0, 80.0, 1.0);
+  staged.setPipelineMode(PipelineMode::Staged);
+  EdgeDetection fused(40.0, 80.0, 1.0);
+
+  cv::Mat expected = staged.cannyEdgeDetection(image).clone();
+  cv::Mat edges = fused.cannyEdgeDetection(image);
+  EXPECT_EQ(cv::countNonZero(edges != expected), 0);
+}
+
+TEST(CannyPipelineTests, FusedMatchesStagedForEveryKernelSize) {
+  const cv::Mat image = testImage(131, 149);
+
+  for (int kernelSize : {3, 5, 7}) {
+    EdgeDetection staged(40.0, 80.0, 1.4f, kernelSize);
+    staged.setPipelineMode(PipelineMode::Staged);
+    EdgeDetection fused(40.0, 80.0, 1.4f, kernelSize);
+
+    cv::Mat expected = staged.cannyEdgeDetection(image).clone();
+    EXPECT_EQ(cv::countNonZero(fused.cannyEdgeDetection(image) != expected), 0) << "kernel size " << kernelSize;
+  }
+}
+
+TEST(CannyPipelineTests, FixedPointFusedMatchesStaged) {
+  const cv::Mat image = testImage(131, 149);
+
+  for (auto norm : {SobelKernels::GradientNorm::L2, SobelKernels::GradientNorm::L1}) {
+    for (int kernelSize : {3, 5, 7}) {
+      EdgeDetection staged(40.0, 80.0, 1.4f, kernelSize);
+      staged.setPipelineMode(PipelineMode::Staged);
+      staged.setPrecision(Precision::FixedPoint);
+      staged.setGradientNorm(norm);
+      EdgeDetection fused(40.0, 80.0, 1.4f, kernelSize);
+      fused.setPrecision(Precision::FixedPoint);
+      fused.setGradientNorm(norm);
+
+      cv::Mat expected = staged.cannyEdgeDetection(image).clone();
+      EXPECT_EQ(cv::countNonZero(fused.cannyEdgeDetection(image) != expected), 0) << "kernel size " << kernelSize;
+    }
+  }
+}
+
+TEST(CannyPipelineTests, FixedPointStaysCloseToFloat) {
+  const cv::Mat image = testImage(203, 157);
+
+  for (int kernelSize : {3, 5, 7}) {
+    EdgeDetection floatDetection(40.0, 80.0, 1.4f, kernelSize);
+    EdgeDetection fixedPoint(40.0, 80.0, 1.4f, kernelSize);
+    fixedPoint.setPrecision(Precision::FixedPoint);
+
+    cv::Mat expected = floatDetection.cannyEdgeDetection(image).clone();
+    const int different = cv::countNonZero(fixedPoint.cannyEdgeDetection(image) != expected);
+    EXPECT_LE(different, static_cast<int>(image.total() / 200)) << "kernel size " << kernelSize;
+  }
+}
+
+TEST(CannyPipelineTests, RejectsUnsupportedKernelSize) {
+  EXPECT_THROW(EdgeDetection(40.0, 80.0, 1.0, 4), std::runtime_error);
+  EXPECT_THROW(EdgeDetection(40.0, 80.0, 1.0, 9), std::runtime_error);
+}
+
+TEST(CannyPipelineTests, InMemoryResultIsBinary) {
+  const cv::Mat image = testImage(120, 90);
+  EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+
+  cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+  ASSERT_EQ(edges.size(), image.size());
+  ASSERT_EQ(edges.type(), CV_8U);
+  EXPECT_GT(cv::countNonZero(edges), 0);
+  EXPECT_EQ(cv::countNonZero(edges) + cv::countNonZero(edges == 0), edges.rows * edges.cols);
+}
+
+TEST(CannyPipelineTests, RejectsEmptyImage) {
+  EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+  EXPECT_THROW(edgeDetection.cannyEdgeDetection(cv::Mat()), std::runtime_error);
+}
+
+TEST(CannyPipelineTests, MultiBandReducesToSingleBand) {
+  const cv::Mat image = testImage(150, 130);
+  EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+  cv::Mat expected = edgeDetection.cannyEdgeDetection(image).clone();
+  cv::Mat edges;
+
+  // A flat band has no gradient, so the maximum is always the textured band
+  const cv::Mat flat = cv::Mat::zeros(image.rows, image.cols, CV_8U);
+  edgeDetection.cannyEdgeDetection({flat, image}, edges, BandCombination::Max);
+  EXPECT_EQ(cv::countNonZero(edges != expected), 0);
+
+  // Two copies weighted by half add up to the original magnitude
+  edgeDetection.cannyEdgeDetection({image, image}, edges, BandCombination::WeightedSum);
+  EXPECT_EQ(cv::countNonZero(edges != expected), 0);
+}
+
+TEST(CannyPipelineTests, MultiBandRejectsMismatchedBands) {
+  EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+  cv::Mat edges;
+  const cv::Mat band = testImage(20, 20);
+  EXPECT_THROW(edgeDetection.cannyEdgeDetection({band, testImage(20, 21)}, edges, BandCombination::Max),
+               std::runtime_error);
+  EXPECT_THROW(edgeDetection.cannyEdgeDetection({band, band}, edges, BandCombination::Max, {1.0f}),
+               std::runtime_error);
+}
+
+TEST(CannyPipelineTests, PreviewFitsTheRequestedSide) {
+  const cv::Mat image = testImage(1000, 730);
+  EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+
+  cv::Mat preview;
+  edgeDetection.previewEdgeDetection(image, preview, 256);
+  EXPECT_EQ(preview.rows, 250);
+  EXPECT_EQ(preview.cols, 183);
+  EXPECT_GT(cv::countNonZero(preview), 0);
+}
+
+TEST(CannyPipelineTests, PreviewOfSmallImageIsFullDetection) {
+  const cv::Mat image = testImage(120, 90);
+  EdgeDetection edgeDetection(40.0, 80.0, 1.0);
+
+  cv::Mat expected = edgeDetection.cannyEdgeDetection(image).clone();
+  cv::Mat preview;
+  edgeDetection.previewEdgeDetection(image, preview, 120);
+  EXPECT_EQ(cv::countNonZero(preview != expected), 0);
+}
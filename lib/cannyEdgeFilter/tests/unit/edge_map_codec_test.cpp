@@ -0,0 +1,104 @@
+#include "edgeMapCodec.hpp"
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+namespace {
+// Sparse map: a few lines and isolated pixels, like the output of the pipeline
+cv::Mat sparseEdges(int rows, int cols) {
+  cv::Mat edges(rows, cols, CV_8U);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      const bool line = row == col || col == cols / 3 || row % 97 == 5;
+      const bool dot = ((row * 7919 + col * 104729) % 1009) == 0;
+      edges.at<uint8_t>(row, col) = (line || dot) ? 255 : 0;
+    }
+  }
+  return edges;
+}
+
+void expectSameEdges(const cv::Mat& expected, const cv::Mat& actual) {
+  ASSERT_EQ(expected.rows, actual.rows);
+  ASSERT_EQ(expected.cols, actual.cols);
+  for (int row = 0; row < expected.rows; ++row) {
+    for (int col = 0; col < expected.cols; ++col) {
+      ASSERT_EQ(expected.at<uint8_t>(row, col) != 0, actual.at<uint8_t>(row, col) == 255)
+          << "row " << row << " col " << col;
+    }
+  }
+}
+}  // namespace
+
+TEST(EdgeMapCodecTests, RoundTripsSparseMaps) {
+  // Odd width for the padding bits, and more rows than an encoding block
+  const cv::Mat edges = sparseEdges(601, 333);
+  std::vector<uint8_t> buffer;
+  EdgeMapCodec::encode(edges, buffer);
+
+  const EdgeMapCodec::Header header = EdgeMapCodec::readHeader(buffer.data(), buffer.size());
+  EXPECT_EQ(header.encoding, EdgeMapCodec::ENCODING_ZERO_RUNS);
+  EXPECT_EQ(header.cols, 333u);
+  EXPECT_EQ(header.rows, 601u);
+  EXPECT_EQ(header.payloadBytes + EdgeMapCodec::HEADER_BYTES, buffer.size());
+  EXPECT_LT(header.payloadBytes, 601u * ((333 + 7) / 8));
+
+  cv::Mat decoded;
+  EdgeMapCodec::decode(buffer.data(), buffer.size(), decoded);
+  expectSameEdges(edges, decoded);
+}
+
+TEST(EdgeMapCodecTests, DenseMapsAreStoredPacked) {
+  cv::Mat edges(40, 21, CV_8U);
+  for (int row = 0; row < edges.rows; ++row) {
+    for (int col = 0; col < edges.cols; ++col) {
+      edges.at<uint8_t>(row, col) = ((row + col) % 2) ? 1 : 0;
+    }
+  }
+  std::vector<uint8_t> buffer;
+  EdgeMapCodec::encode(edges, buffer);
+
+  const EdgeMapCodec::Header header = EdgeMapCodec::readHeader(buffer.data(), buffer.size());
+  EXPECT_EQ(header.encoding, EdgeMapCodec::ENCODING_PACKED);
+  EXPECT_EQ(header.payloadBytes, 40u * 3u);
+  // First pixel in the most significant bit, the padding bits zero
+  EXPECT_EQ(buffer[EdgeMapCodec::HEADER_BYTES], 0x55);
+  EXPECT_EQ(buffer[EdgeMapCodec::HEADER_BYTES + 2], 0x50);
+
+  cv::Mat decoded;
+  EdgeMapCodec::decode(buffer.data(), buffer.size(), decoded);
+  expectSameEdges(edges, decoded);
+}
+
+TEST(EdgeMapCodecTests, EmptyMapIsAlmostOnlyTheHeader) {
+  const cv::Mat edges = cv::Mat::zeros(1000, 1000, CV_8U);
+  std::vector<uint8_t> buffer;
+  EdgeMapCodec::encode(edges, buffer);
+  EXPECT_LT(buffer.size(), EdgeMapCodec::HEADER_BYTES + 16);
+
+  cv::Mat decoded;
+  EdgeMapCodec::decode(buffer.data(), buffer.size(), decoded);
+  expectSameEdges(edges, decoded);
+}
+
+TEST(EdgeMapCodecTests, RejectsMalformedInput) {
+  std::vector<uint8_t> buffer;
+  EdgeMapCodec::encode(sparseEdges(300, 64), buffer);
+  cv::Mat decoded;
+
+  EXPECT_THROW(EdgeMapCodec::decode(buffer.data(), EdgeMapCodec::HEADER_BYTES - 1, decoded), std::runtime_error);
+  EXPECT_THROW(EdgeMapCodec::decode(buffer.data(), buffer.size() - 1, decoded), std::runtime_error);
+
+  std::vector<uint8_t> corrupt = buffer;
+  corrupt[0] = 'X';
+  EXPECT_THROW(EdgeMapCodec::decode(corrupt.data(), corrupt.size(), decoded), std::runtime_error);
+
+  corrupt = buffer;
+  corrupt[4] = EdgeMapCodec::VERSION + 1;
+  EXPECT_THROW(EdgeMapCodec::decode(corrupt.data(), corrupt.size(), decoded), std::runtime_error);
+
+  // Tokens for fewer rows than the header says
+  corrupt = buffer;
+  corrupt[12] += 1;
+  EXPECT_THROW(EdgeMapCodec::decode(corrupt.data(), corrupt.size(), decoded), std::runtime_error);
+
+  EXPECT_THROW(EdgeMapCodec::encode(cv::Mat(), buffer), std::runtime_error);
+}
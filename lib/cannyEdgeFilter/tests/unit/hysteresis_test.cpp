@@ -0,0 +1,91 @@
+#include "hysteresis.hpp"
+#include <gtest/gtest.h>
+#include <omp.h>
+#include <queue>
+#include <random>
+
+namespace {
+// Serial breadth first search from every strong pixel, the textbook definition of hysteresis
+cv::Mat referenceHysteresis(const cv::Mat& suppressed, float low, float high) {
+  cv::Mat edges = cv::Mat::zeros(suppressed.rows, suppressed.cols, CV_8U);
+  std::queue<cv::Point> pending;
+  for (int row = 0; row < suppressed.rows; ++row) {
+    for (int col = 0; col < suppressed.cols; ++col) {
+      if (suppressed.at<uint8_t>(row, col) >= high) {
+        edges.at<uint8_t>(row, col) = 255;
+        pending.emplace(col, row);
+      }
+    }
+  }
+  while (!pending.empty()) {
+    cv::Point pixel = pending.front();
+    pending.pop();
+    for (int row = pixel.y - 1; row <= pixel.y + 1; ++row) {
+      for (int col = pixel.x - 1; col <= pixel.x + 1; ++col) {
+        if (row < 0 || col < 0 || row >= suppressed.rows || col >= suppressed.cols) {
+          continue;
+        }
+        if (edges.at<uint8_t>(row, col) == 0 && suppressed.at<uint8_t>(row, col) >= low) {
+          edges.at<uint8_t>(row, col) = 255;
+          pending.emplace(col, row);
+        }
+      }
+    }
+  }
+  return edges;
+}
+
+cv::Mat randomImage(int rows, int cols, unsigned seed) {
+  cv::Mat image(rows, cols, CV_8U);
+  std::mt19937 generator(seed);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>(distribution(generator));
+    }
+  }
+  return image;
+}
+} // namespace
+
+TEST(HysteresisTests, MatchesSerialReference) {
+  // Thresholds that leave many weak pixels, so components span many strips
+  const cv::Mat suppressed = randomImage(301, 257, 11);
+  const cv::Mat expected = referenceHysteresis(suppressed, 100, 250);
+  const int maxThreads = omp_get_max_threads();
+
+  for (int threads : {1, 2, 3, 8}) {
+    omp_set_num_threads(threads);
+    for (int stripRows : {1, 2, 7, 64, 1000}) {
+      cv::Mat edges;
+      Hysteresis::hysteresis(suppressed, edges, 100, 250, stripRows);
+      ASSERT_EQ(cv::countNonZero(edges != expected), 0) << threads << " threads, " << stripRows << " rows per strip";
+    }
+  }
+  omp_set_num_threads(maxThreads);
+}
+
+TEST(HysteresisTests, LongChainAcrossStrips) {
+  // A zig-zag weak chain crossing every strip boundary many times, fed by a single strong pixel at its far end
+  const int rows = 64;
+  const int cols = 2000;
+  cv::Mat suppressed = cv::Mat::zeros(rows, cols, CV_8U);
+  for (int col = 0; col < cols; ++col) {
+    int phase = col % (2 * (rows - 1));
+    suppressed.at<uint8_t>(phase < rows ? phase : 2 * (rows - 1) - phase, col) = 50;
+  }
+  suppressed.at<uint8_t>(0, 0) = 200;
+
+  cv::Mat edges;
+  Hysteresis::hysteresis(suppressed, edges, 40, 80, 4);
+  EXPECT_EQ(cv::countNonZero(edges), cols);
+  EXPECT_EQ(cv::countNonZero(edges != referenceHysteresis(suppressed, 40, 80)), 0);
+}
+
+TEST(HysteresisTests, InPlaceIsBinary) {
+  cv::Mat image = randomImage(50, 60, 3);
+  const cv::Mat expected = referenceHysteresis(image, 100, 200);
+  Hysteresis::hysteresis(image, image, 100, 200);
+  EXPECT_EQ(cv::countNonZero(image != expected), 0);
+  EXPECT_EQ(cv::countNonZero(image) + cv::countNonZero(image == 0), 50 * 60);
+}
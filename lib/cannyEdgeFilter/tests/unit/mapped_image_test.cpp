@@ -0,0 +1,112 @@
+#include "imageFileOperations.hpp"
+#include "mappedImage.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+cv::Mat testImage(int rows, int cols) {
+  cv::Mat image(rows, cols, CV_8U);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>(row * 31 + col * 7);
+    }
+  }
+  return image;
+}
+
+void expectSamePixels(const cv::Mat& expected, const cv::Mat& actual) {
+  ASSERT_EQ(expected.rows, actual.rows);
+  ASSERT_EQ(expected.cols, actual.cols);
+  for (int row = 0; row < expected.rows; ++row) {
+    for (int col = 0; col < expected.cols; ++col) {
+      ASSERT_EQ(expected.at<uint8_t>(row, col), actual.at<uint8_t>(row, col)) << "row " << row << " col " << col;
+    }
+  }
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+}
+}  // namespace
+
+TEST(MappedImageTests, MapsAlignedRawImages) {
+  const std::string path = "/tmp/mapped_image_test.raw";
+  const cv::Mat image = testImage(37, 45);
+  ImageFileOperations imageFileOperations;
+  ASSERT_TRUE(imageFileOperations.saveRawImage(path, image));
+
+  MappedImage mapped(path);
+  EXPECT_EQ(mapped.mat().step, 64u);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped.mat().data) % 64, 0u);
+  expectSamePixels(image, mapped.mat());
+
+  // The mapping moves with the object
+  MappedImage moved = std::move(mapped);
+  EXPECT_TRUE(mapped.mat().empty());
+  expectSamePixels(image, moved.mat());
+  std::remove(path.c_str());
+}
+
+TEST(MappedImageTests, MapsBinaryPgm) {
+  const std::string path = "/tmp/mapped_image_test.pgm";
+  const cv::Mat image = testImage(5, 7);
+  std::string contents = "P5\n# a comment\n7 5\n255\n";
+  contents.append(reinterpret_cast<const char*>(image.data), image.total());
+  writeFile(path, contents);
+
+  EXPECT_TRUE(MappedImage::isMappable(path));
+  MappedImage mappedImage;
+  ImageFileOperations imageFileOperations;
+  const cv::Mat opened = imageFileOperations.openImage(path, mappedImage);
+  EXPECT_EQ(opened.data, mappedImage.mat().data);
+  expectSamePixels(image, opened);
+  std::remove(path.c_str());
+}
+
+TEST(MappedImageTests, RejectsUnsupportedOrTruncatedFiles) {
+  const std::string path = "/tmp/mapped_image_test_bad.pgm";
+
+  writeFile(path, "P5\n7 5\n65535\n" + std::string(70, '\0'));
+  EXPECT_THROW(MappedImage{path}, std::runtime_error);
+
+  writeFile(path, "P5\n7 5\n255\n" + std::string(34, '\0'));
+  EXPECT_THROW(MappedImage{path}, std::runtime_error);
+
+  writeFile(path, "P2\n1 1\n255\n0\n");
+  EXPECT_FALSE(MappedImage::isMappable(path));
+  EXPECT_THROW(MappedImage{path}, std::runtime_error);
+
+  std::remove(path.c_str());
+  EXPECT_THROW(MappedImage{path}, std::runtime_error);
+}
+
+TEST(MappedImageTests, ReadsIntoAPooledBuffer) {
+  const std::string path = "/tmp/mapped_image_test_read.raw";
+  const cv::Mat image = testImage(37, 45);
+  ImageFileOperations imageFileOperations;
+  ASSERT_TRUE(imageFileOperations.saveRawImage(path, image));
+
+  MappedImage read(path, MappedImage::Access::Read);
+  EXPECT_TRUE(read.mat().isContinuous());
+  expectSamePixels(image, read.mat());
+
+  // The pixels are a copy, rewriting the file afterwards doesn't reach them
+  writeFile(path, "RAW8");
+  expectSamePixels(image, read.mat());
+  EXPECT_THROW(MappedImage(path, MappedImage::Access::Read), std::runtime_error);
+
+  const std::string pgmPath = "/tmp/mapped_image_test_read.pgm";
+  std::string contents = "P5\n# a comment\n45 37\n255\n";
+  contents.append(reinterpret_cast<const char*>(image.data), image.total());
+  writeFile(pgmPath, contents);
+  MappedImage mappedImage;
+  expectSamePixels(image, imageFileOperations.openImage(pgmPath, mappedImage, MappedImage::Access::Read));
+
+  writeFile(pgmPath, contents.substr(0, contents.size() - 1));
+  EXPECT_THROW(MappedImage(pgmPath, MappedImage::Access::Read), std::runtime_error);
+  std::remove(path.c_str());
+  std::remove(pgmPath.c_str());
+}
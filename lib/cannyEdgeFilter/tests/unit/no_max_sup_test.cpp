@@ -1,57 +1,51 @@
-#include "CannyEdgeFilter.hpp"
+#include "cannyEdgeFilter.hpp"
 #include <gtest/gtest.h>
 
-#define DEGRESS_TO_RAD(angle) ((angle * CV_PI) / 180)
-
-TEST(NonMaxSuppTests, NonMaxSupp) {
-  cv::Mat testImage(5, 5, CV_32F);
-
-  // High values
-  testImage.at<uint8_t>(0, 0) = 30;
-  testImage.at<uint8_t>(0, 2) = 30;
-  testImage.at<uint8_t>(0, 4) = 30;
-  testImage.at<uint8_t>(2, 0) = 30;
-
-  // Middle values
-  testImage.at<uint8_t>(1, 1) = 10;
-  testImage.at<uint8_t>(1, 2) = 10;
-  testImage.at<uint8_t>(1, 3) = 10;
-  testImage.at<uint8_t>(2, 1) = 10;
-  testImage.at<uint8_t>(2, 2) = 10;
-  testImage.at<uint8_t>(2, 3) = 10;
-  testImage.at<uint8_t>(3, 1) = 10;
-  testImage.at<uint8_t>(3, 2) = 10;
-  testImage.at<uint8_t>(3, 3) = 10;
-
-  // Low values
-  testImage.at<uint8_t>(2, 4) = 5;
-  testImage.at<uint8_t>(4, 0) = 5;
-  testImage.at<uint8_t>(4, 2) = 5;
-  testImage.at<uint8_t>(4, 4) = 5;
-
-  cv::Mat testDirs(5, 5, CV_32F);
-  testDirs.at<float>(1, 1) = DEGRESS_TO_RAD(157);  // 135
-  testDirs.at<float>(1, 2) = DEGRESS_TO_RAD(68);   // 90
-  testDirs.at<float>(1, 3) = DEGRESS_TO_RAD(23);   // 45
-  testDirs.at<float>(2, 1) = DEGRESS_TO_RAD(22);   // 0
-  testDirs.at<float>(2, 2) = DEGRESS_TO_RAD(0);    // 0
-  testDirs.at<float>(2, 3) = DEGRESS_TO_RAD(-158); // 0
-  testDirs.at<float>(3, 1) = DEGRESS_TO_RAD(-157); // 45
-  testDirs.at<float>(3, 2) = DEGRESS_TO_RAD(-22);  // 90
-  testDirs.at<float>(3, 3) = DEGRESS_TO_RAD(-23);  // 135
-
-  cv::Mat testResults(5, 5, CV_32F);
-
-  EdgeDetection edgeDetection;
-
-  edgeDetection.nonMaximumSuppression(testImage, testDirs, testResults);
-
-  ASSERT_EQ(testResults.at<uint8_t>(1, 1), 0);
-  ASSERT_EQ(testResults.at<uint8_t>(1, 2), 0);
-  ASSERT_EQ(testResults.at<uint8_t>(1, 3), 0);
-  ASSERT_EQ(testResults.at<uint8_t>(2, 1), 0);
-  ASSERT_EQ(testResults.at<uint8_t>(2, 3), 10);
-  ASSERT_EQ(testResults.at<uint8_t>(3, 1), 10);
-  ASSERT_EQ(testResults.at<uint8_t>(3, 2), 10);
-  ASSERT_EQ(testResults.at<uint8_t>(3, 3), 10);
+namespace {
+// The image border is an edge against the padding, so only the interior is checked
+constexpr int MARGIN = 4;
+
+// Blurred step edges spread the gradient over several pixels, suppression keeps only the ridge
+int edgePixelsInRow(const cv::Mat& edges, int row) {
+  return cv::countNonZero(edges(cv::Rect(MARGIN, row, edges.cols - 2 * MARGIN, 1)));
+}
+
+int edgePixelsInCol(const cv::Mat& edges, int col) {
+  return cv::countNonZero(edges(cv::Rect(col, MARGIN, 1, edges.rows - 2 * MARGIN)));
+}
+} // namespace
+
+TEST(NonMaxSuppTests, VerticalStepGivesThinEdge) {
+  cv::Mat image(64, 64, CV_8U, cv::Scalar(20));
+  image(cv::Rect(32, 0, 32, 64)).setTo(220);
+
+  for (PipelineMode mode : {PipelineMode::Staged, PipelineMode::Fused}) {
+    EdgeDetection edgeDetection(40, 80, 1.5);
+    edgeDetection.setPipelineMode(mode);
+    cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+    for (int row = MARGIN; row < image.rows - MARGIN; ++row) {
+      ASSERT_EQ(edgePixelsInRow(edges, row), 1) << "row " << row;
+    }
+  }
+}
+
+TEST(NonMaxSuppTests, HorizontalStepGivesThinEdge) {
+  cv::Mat image(64, 64, CV_8U, cv::Scalar(220));
+  image(cv::Rect(0, 32, 64, 32)).setTo(20);
+
+  for (PipelineMode mode : {PipelineMode::Staged, PipelineMode::Fused}) {
+    EdgeDetection edgeDetection(40, 80, 1.5);
+    edgeDetection.setPipelineMode(mode);
+    cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+    for (int col = MARGIN; col < image.cols - MARGIN; ++col) {
+      ASSERT_EQ(edgePixelsInCol(edges, col), 1) << "col " << col;
+    }
+  }
+}
+
+TEST(NonMaxSuppTests, FlatImageHasNoEdges) {
+  cv::Mat image(32, 32, CV_8U, cv::Scalar(128));
+  EdgeDetection edgeDetection(40, 80, 1.0);
+  cv::Mat edges = edgeDetection.cannyEdgeDetection(image);
+  EXPECT_EQ(cv::countNonZero(edges(cv::Rect(MARGIN, MARGIN, 32 - 2 * MARGIN, 32 - 2 * MARGIN))), 0);
 }
@@ -0,0 +1,83 @@
+#include "cannyEdgeFilter.hpp"
+#include "numaPlacement.hpp"
+#include <gtest/gtest.h>
+#include <omp.h>
+#include <sched.h>
+#include <set>
+
+TEST(NumaPlacementTests, TopologyCoversTheCpusOfTheProcess) {
+  const std::vector<NumaPlacement::Node>& nodes = NumaPlacement::topology();
+  ASSERT_FALSE(nodes.empty());
+
+  cpu_set_t allowed;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  std::set<int> seen;
+  for (const NumaPlacement::Node& node : nodes) {
+    EXPECT_FALSE(node.cpus.empty());
+    for (int cpu : node.cpus) {
+      EXPECT_TRUE(CPU_ISSET(cpu, &allowed)) << "cpu " << cpu;
+      EXPECT_TRUE(seen.insert(cpu).second) << "cpu " << cpu << " in two nodes";
+    }
+  }
+}
+
+TEST(NumaPlacementTests, CoreAffinityPinsEveryThreadToOneCpu) {
+  const int threads = 4;
+  NumaPlacement::pinThreads(ThreadAffinity::Core, threads);
+
+  std::vector<int> cpuCounts(threads, 0);
+  #pragma omp parallel num_threads(threads)
+  {
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(set), &set);
+    cpuCounts[omp_get_thread_num()] = CPU_COUNT(&set);
+  }
+  for (int count : cpuCounts) {
+    EXPECT_EQ(count, 1);
+  }
+
+  // None gives the threads back every CPU of the process
+  NumaPlacement::pinThreads(ThreadAffinity::None, threads);
+  size_t cpus = 0;
+  for (const NumaPlacement::Node& node : NumaPlacement::topology()) {
+    cpus += node.cpus.size();
+  }
+  #pragma omp parallel num_threads(threads)
+  {
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(set), &set);
+    cpuCounts[omp_get_thread_num()] = CPU_COUNT(&set);
+  }
+  for (int count : cpuCounts) {
+    EXPECT_EQ(static_cast<size_t>(count), cpus);
+  }
+}
+
+TEST(NumaPlacementTests, FirstTouchZeroesOnlyTheView) {
+  cv::Mat image(8, 8, CV_8U, cv::Scalar(7));
+  cv::Mat view = image(cv::Rect(2, 2, 4, 4));
+  NumaPlacement::firstTouch(view);
+
+  EXPECT_EQ(cv::countNonZero(view), 0);
+  EXPECT_EQ(cv::countNonZero(image), 64 - 16);
+}
+
+TEST(NumaPlacementTests, PinnedJobGivesTheCallerItsCpusBack) {
+  cpu_set_t before;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(before), &before), 0);
+
+  cv::Mat image(64, 64, CV_8U, cv::Scalar(0));
+  image(cv::Rect(16, 16, 32, 32)).setTo(cv::Scalar(255));
+  for (ThreadAffinity affinity : {ThreadAffinity::Core, ThreadAffinity::Node}) {
+    EdgeDetection edgeDetection(20, 60, 1.0);
+    edgeDetection.setThreadAffinity(affinity);
+    edgeDetection.setTimers(false);
+    edgeDetection.cannyEdgeDetection(image);
+
+    // The caller starts the compression threads of the server, they inherit its mask
+    cpu_set_t after;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(after), &after), 0);
+    EXPECT_TRUE(CPU_EQUAL(&before, &after));
+  }
+  NumaPlacement::pinThreads(ThreadAffinity::None);
+}
@@ -0,0 +1,43 @@
+#include "cannyOracle.hpp"
+#include <gtest/gtest.h>
+
+TEST(OracleTests, AcceleratedVariantsMatchReference) {
+  for (int kernelSize : {3, 5, 7}) {
+    CannyOracle::Parameters parameters;
+    parameters.kernelSize = kernelSize;
+    parameters.sigma = 1.2f;
+
+    for (const auto& [name, image] : CannyOracle::syntheticCorpus()) {
+      const cv::Mat expected = CannyOracle::reference(image, parameters);
+      for (const CannyOracle::Variant& variant : CannyOracle::variants()) {
+        if (!variant.exact) {
+          continue;
+        }
+        const CannyOracle::Comparison comparison = CannyOracle::compare(expected, variant.run(image, parameters));
+        EXPECT_EQ(comparison.differentPixels, 0)
+            << variant.name << " on " << name << " with kernel " << kernelSize << ", PSNR " << comparison.psnr;
+      }
+    }
+  }
+}
+
+TEST(OracleTests, ReferenceStaysCloseToTextbookCanny) {
+  const CannyOracle::Parameters parameters;
+  for (const auto& [name, image] : CannyOracle::syntheticCorpus()) {
+    const CannyOracle::Comparison comparison =
+        CannyOracle::compare(CannyOracle::textbookCanny(image, parameters), CannyOracle::reference(image, parameters));
+    EXPECT_LE(comparison.differentPixels, static_cast<int>(image.total() / 100)) << name;
+  }
+}
+
+TEST(OracleTests, CompareReportsDifferencesAndPsnr) {
+  cv::Mat expected(10, 10, CV_8U, cv::Scalar(0));
+  cv::Mat actual = expected.clone();
+  EXPECT_EQ(CannyOracle::compare(expected, actual).differentPixels, 0);
+  EXPECT_TRUE(std::isinf(CannyOracle::compare(expected, actual).psnr));
+
+  actual.at<uint8_t>(3, 3) = 255;
+  const CannyOracle::Comparison comparison = CannyOracle::compare(expected, actual);
+  EXPECT_EQ(comparison.differentPixels, 1);
+  EXPECT_NEAR(comparison.psnr, 20.0, 1e-9);
+}
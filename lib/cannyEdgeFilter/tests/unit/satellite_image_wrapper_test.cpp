@@ -0,0 +1,131 @@
+#include "satelliteImageWrapper.hpp"
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <gdal_priv.h>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+// Isolated bright squares on a dark background: every edge is strong and closes within a few pixels, so no chain
+// reaches past the halo of a tile and the tiled result must match the whole image exactly. Values span 0-255, so the
+// scaling to 8-bit keeps them as they are
+cv::Mat sceneImage(int rows, int cols) {
+  cv::Mat image(rows, cols, CV_8U);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      const bool square = (row % 23) >= 6 && (row % 23) < 16 && (col % 19) >= 5 && (col % 19) < 14;
+      image.at<uint8_t>(row, col) = square ? 255 : static_cast<uint8_t>((row + col) % 3);
+    }
+  }
+  return image;
+}
+
+// The tests write their inputs as GeoTIFF, a GDAL built without the driver skips them
+bool hasGeoTiffDriver() {
+  GDALAllRegister();
+  return GetGDALDriverManager()->GetDriverByName("GTiff") != nullptr;
+}
+
+// Writes an image as a single band GeoTIFF in GDAL's in-memory file system, tiled in blocks smaller than the image
+void writeGeoTiff(const std::string& path, const cv::Mat& image, int blockSize) {
+  GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+  ASSERT_NE(driver, nullptr);
+  const std::string block = std::to_string(blockSize);
+  char** options = nullptr;
+  options = CSLSetNameValue(options, "TILED", "YES");
+  options = CSLSetNameValue(options, "BLOCKXSIZE", block.c_str());
+  options = CSLSetNameValue(options, "BLOCKYSIZE", block.c_str());
+  GDALDataset* dataset = driver->Create(path.c_str(), image.cols, image.rows, 1, GDT_Byte, options);
+  CSLDestroy(options);
+  ASSERT_NE(dataset, nullptr);
+  cv::Mat copy = image.clone();
+  EXPECT_EQ(dataset->GetRasterBand(1)->RasterIO(GF_Write, 0, 0, image.cols, image.rows, copy.data, image.cols,
+                                                image.rows, GDT_Byte, 0, 0),
+            CE_None);
+  GDALClose(dataset);
+}
+
+cv::Mat readGeoTiff(const std::string& path) {
+  GDALDataset* dataset = static_cast<GDALDataset*>(GDALOpen(path.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    return cv::Mat();
+  }
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+  cv::Mat image(band->GetYSize(), band->GetXSize(), CV_8U);
+  if (band->RasterIO(GF_Read, 0, 0, image.cols, image.rows, image.data, image.cols, image.rows, GDT_Byte, 0, 0) !=
+      CE_None) {
+    image.release();
+  }
+  GDALClose(dataset);
+  return image;
+}
+} // namespace
+
+TEST(SatelliteImageWrapperTests, ReadWindowMatchesTheBand) {
+  if (!hasGeoTiffDriver()) {
+    GTEST_SKIP() << "GDAL has no GTiff driver";
+  }
+  const std::string input = "/vsimem/satellite_window.tif";
+  const cv::Mat image = sceneImage(150, 200);
+  writeGeoTiff(input, image, 64);
+
+  {
+    SatelliteImageWrapper wrapper(input);
+    const cv::Mat band = wrapper.readBand(1);
+    EXPECT_EQ(cv::countNonZero(band != image), 0);
+
+    // A window across four blocks
+    const cv::Rect window(50, 40, 70, 60);
+    const cv::Mat read = wrapper.readWindow(1, window);
+    ASSERT_EQ(read.rows, window.height);
+    ASSERT_EQ(read.cols, window.width);
+    EXPECT_EQ(cv::countNonZero(read != image(window)), 0);
+  }
+  VSIUnlink(input.c_str());
+}
+
+TEST(SatelliteImageWrapperTests, TiledDetectionMatchesTheWholeImage) {
+  if (!hasGeoTiffDriver()) {
+    GTEST_SKIP() << "GDAL has no GTiff driver";
+  }
+  const std::string input = "/vsimem/satellite_input.tif";
+  const std::string output = "/vsimem/satellite_edges.tif";
+  const cv::Mat image = sceneImage(150, 200);
+  writeGeoTiff(input, image, 64);
+
+  // Every kernel size fits in the halo
+  for (int kernelSize : {3, 5, 7}) {
+    EdgeDetection edgeDetection(40.0, 80.0, 1.0, kernelSize);
+    edgeDetection.setTimers(false);
+    cv::Mat expected;
+    edgeDetection.cannyEdgeDetection(image, expected);
+    ASSERT_GT(cv::countNonZero(expected), 0);
+
+    {
+      // 4 x 3 tiles, the last column and row of them cut by the border of the scene
+      SatelliteImageWrapper wrapper(input);
+      wrapper.detectEdgesTiled(1, output, 40.0, 80.0, 1.0, 64, kernelSize);
+    }
+    const cv::Mat tiled = readGeoTiff(output);
+    ASSERT_EQ(tiled.rows, image.rows);
+    ASSERT_EQ(tiled.cols, image.cols);
+    EXPECT_EQ(cv::countNonZero(tiled != expected), 0) << "kernel size " << kernelSize;
+  }
+
+  VSIUnlink(input.c_str());
+  VSIUnlink(output.c_str());
+}
+
+TEST(SatelliteImageWrapperTests, TiledDetectionRejectsInvalidSizes) {
+  if (!hasGeoTiffDriver()) {
+    GTEST_SKIP() << "GDAL has no GTiff driver";
+  }
+  const std::string input = "/vsimem/satellite_unaligned.tif";
+  writeGeoTiff(input, sceneImage(32, 32), 16);
+  {
+    SatelliteImageWrapper wrapper(input);
+    EXPECT_THROW(wrapper.detectEdgesTiled(1, "/vsimem/unused.tif", 40.0, 80.0, 1.0, 40), std::runtime_error);
+    EXPECT_THROW(wrapper.detectEdgesTiled(1, "/vsimem/unused.tif", 40.0, 80.0, 1.0, 32, 9), std::runtime_error);
+  }
+  VSIUnlink(input.c_str());
+}
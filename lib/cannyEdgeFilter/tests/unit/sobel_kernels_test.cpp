@@ -0,0 +1,88 @@
+#include "sobelKernels.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using SobelKernels::GradientNorm;
+using SobelKernels::SimdLevel;
+
+TEST(SobelKernelsTests, SimdMatchesScalar) {
+  const int rows = 32;
+  const int cols = 1003; // Not a multiple of any vector width, so the scalar tails run too
+  std::vector<uint8_t> image(rows * cols);
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  for (auto& pixel : image) {
+    pixel = static_cast<uint8_t>(distribution(generator));
+  }
+  // Saturated patterns reach the largest gradients
+  for (int col = 0; col < cols; ++col) {
+    image[5 * cols + col] = (col % 2) * 255;
+    image[6 * cols + col] = 255;
+  }
+
+  std::vector<uint16_t> refMagnitude(cols), magnitude(cols);
+  std::vector<uint8_t> refDirection(cols), direction(cols);
+
+  for (auto norm : {GradientNorm::L2, GradientNorm::L1}) {
+    const auto scalar = SobelKernels::getSobelRow(SimdLevel::Scalar, norm);
+    for (auto level : {SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+      const auto simd = SobelKernels::getSobelRow(level, norm);
+      for (int row = 1; row < rows - 1; ++row) {
+        const uint8_t* above = &image[(row - 1) * cols];
+        const uint8_t* center = &image[row * cols];
+        const uint8_t* below = &image[(row + 1) * cols];
+        scalar(above, center, below, refMagnitude.data(), refDirection.data(), cols);
+        simd(above, center, below, magnitude.data(), direction.data(), cols);
+        for (int col = 1; col < cols - 1; ++col) {
+          ASSERT_EQ(refMagnitude[col], magnitude[col]) << SobelKernels::simdLevelName(level) << " col " << col;
+          ASSERT_EQ(refDirection[col], direction[col]) << SobelKernels::simdLevelName(level) << " col " << col;
+        }
+      }
+    }
+  }
+}
+
+TEST(SobelKernelsTests, L1MagnitudeAddsAbsoluteGradients) {
+  // Bright upper-right corner: gx = 3 * 255, gy = 3 * 255
+  const uint8_t above[3] = {0, 255, 255};
+  const uint8_t center[3] = {0, 0, 255};
+  const uint8_t dark[3] = {0, 0, 0};
+  uint16_t l1[3];
+  uint16_t l2[3];
+  uint8_t direction[3];
+  SobelKernels::getSobelRow(SimdLevel::Scalar, GradientNorm::L1)(above, center, dark, l1, direction, 3);
+  SobelKernels::getSobelRow(SimdLevel::Scalar, GradientNorm::L2)(above, center, dark, l2, direction, 3);
+  EXPECT_EQ(l1[1], (6 * 255) << SobelKernels::MAGNITUDE_FRACTION_BITS);
+  EXPECT_NEAR(l1[1] / std::sqrt(2.0), l2[1], 1.0);
+}
+
+TEST(SobelKernelsTests, DirectionSectors) {
+  // Vertical edge: horizontal gradient
+  const uint8_t left[3] = {0, 0, 255};
+  uint16_t magnitude[3];
+  uint8_t direction[3];
+  const auto scalar = SobelKernels::getSobelRow(SimdLevel::Scalar);
+  scalar(left, left, left, magnitude, direction, 3);
+  ASSERT_EQ(direction[1], SobelKernels::DIRECTION_0);
+  ASSERT_EQ(magnitude[1], (4 * 255) << SobelKernels::MAGNITUDE_FRACTION_BITS);
+
+  // Horizontal edge: vertical gradient
+  const uint8_t dark[3] = {0, 0, 0};
+  const uint8_t bright[3] = {255, 255, 255};
+  scalar(bright, dark, dark, magnitude, direction, 3);
+  ASSERT_EQ(direction[1], SobelKernels::DIRECTION_90);
+
+  // Bright upper-right corner: gradient at 45 degrees
+  const uint8_t above[3] = {0, 255, 255};
+  const uint8_t center[3] = {0, 0, 255};
+  scalar(above, center, dark, magnitude, direction, 3);
+  ASSERT_EQ(direction[1], SobelKernels::DIRECTION_45);
+
+  // Bright upper-left corner: gradient at 135 degrees
+  const uint8_t aboveLeft[3] = {255, 255, 0};
+  const uint8_t centerLeft[3] = {255, 0, 0};
+  scalar(aboveLeft, centerLeft, dark, magnitude, direction, 3);
+  ASSERT_EQ(direction[1], SobelKernels::DIRECTION_135);
+}
@@ -0,0 +1,105 @@
+#include "cannyEdgeFilter.hpp"
+#include "suppressionCache.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+cv::Mat testImage(int rows, int cols) {
+  cv::Mat image(rows, cols, CV_8U);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      image.at<uint8_t>(row, col) = static_cast<uint8_t>(((row / 16 + col / 24) % 2) * 120 + (row * 7 + col * 3) % 40);
+    }
+  }
+  return image;
+}
+
+int countDifferences(const cv::Mat& a, const cv::Mat& b) {
+  int different = 0;
+  for (int row = 0; row < a.rows; ++row) {
+    for (int col = 0; col < a.cols; ++col) {
+      different += a.at<uint8_t>(row, col) != b.at<uint8_t>(row, col);
+    }
+  }
+  return different;
+}
+}  // namespace
+
+TEST(SuppressionCacheTests, RethresholdingHitsAndMatchesFullRuns) {
+  const cv::Mat image = testImage(130, 150);
+  SuppressionCache cache;
+
+  EdgeDetection warm(40.0, 80.0, 1.0);
+  warm.setSuppressionCache(&cache);
+  cv::Mat edges;
+  warm.cannyEdgeDetection(image, edges);
+  EXPECT_EQ(cache.hits(), 0u);
+  EXPECT_EQ(cache.cachedBytes(), image.total());
+
+  // A reloaded copy of the image, with other thresholds, only runs the hysteresis
+  EdgeDetection retuned(20.0, 120.0, 1.0);
+  retuned.setSuppressionCache(&cache);
+  cv::Mat cachedEdges;
+  retuned.cannyEdgeDetection(image.clone(), cachedEdges);
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(retuned.getStageTimes().fusedSuppression, 0.0);
+
+  EdgeDetection uncached(20.0, 120.0, 1.0);
+  cv::Mat expected;
+  uncached.cannyEdgeDetection(image, expected);
+  EXPECT_EQ(countDifferences(expected, cachedEdges), 0);
+}
+
+TEST(SuppressionCacheTests, BlurSettingsAndPixelsAreInTheKey) {
+  cv::Mat image = testImage(64, 64);
+  SuppressionCache cache;
+
+  EdgeDetection detector(40.0, 80.0, 1.0);
+  detector.setSuppressionCache(&cache);
+  cv::Mat edges;
+  detector.cannyEdgeDetection(image, edges);
+
+  EdgeDetection otherSigma(40.0, 80.0, 1.5);
+  otherSigma.setSuppressionCache(&cache);
+  otherSigma.cannyEdgeDetection(image, edges);
+
+  EdgeDetection fixedPoint(40.0, 80.0, 1.0);
+  fixedPoint.setSuppressionCache(&cache);
+  fixedPoint.setPrecision(Precision::FixedPoint);
+  fixedPoint.cannyEdgeDetection(image, edges);
+
+  image.at<uint8_t>(40, 33) ^= 1;
+  detector.cannyEdgeDetection(image, edges);
+  EXPECT_EQ(cache.hits(), 0u);
+  EXPECT_EQ(cache.cachedBytes(), 4 * image.total());
+}
+
+TEST(SuppressionCacheTests, DropsLeastRecentlyUsedMaps) {
+  SuppressionCache cache(2 * 100);
+  const cv::Mat map = cv::Mat::zeros(10, 10, CV_8U);
+  SuppressionCache::Key first{1, 10, 10, 1.0f, 3, 0};
+  SuppressionCache::Key second{2, 10, 10, 1.0f, 3, 0};
+  SuppressionCache::Key third{3, 10, 10, 1.0f, 3, 0};
+
+  cache.insert(first, map);
+  cache.insert(second, map);
+  cv::Mat found;
+  EXPECT_TRUE(cache.find(first, found));
+  cache.insert(third, map);
+
+  EXPECT_EQ(cache.cachedBytes(), 200u);
+  EXPECT_TRUE(cache.find(first, found));
+  EXPECT_FALSE(cache.find(second, found));
+  EXPECT_TRUE(cache.find(third, found));
+
+  // Maps larger than the cache are not kept
+  cache.insert(second, cv::Mat::zeros(20, 20, CV_8U));
+  EXPECT_FALSE(cache.find(second, found));
+}
+
+TEST(SuppressionCacheTests, HashIgnoresStride) {
+  const cv::Mat image = testImage(50, 70);
+  const cv::Mat padded = testImage(52, 90);
+  const cv::Mat view = padded(cv::Rect(0, 0, 70, 50));
+  EXPECT_EQ(SuppressionCache::hashImage(image), SuppressionCache::hashImage(view));
+  EXPECT_NE(SuppressionCache::hashImage(image), SuppressionCache::hashImage(testImage(70, 50)));
+}
@@ -0,0 +1,31 @@
+#include "workspacePool.hpp"
+#include <gtest/gtest.h>
+
+TEST(WorkspacePoolTests, ReusesReleasedBuffers) {
+  WorkspacePool pool;
+  uchar* data = nullptr;
+  {
+    WorkspacePool::Lease lease = pool.acquire(10, 20, CV_32F);
+    data = lease.mat().data;
+  }
+  EXPECT_EQ(pool.allocations(), 1u);
+  EXPECT_EQ(pool.cachedBytes(), 10u * 20u * sizeof(float));
+
+  WorkspacePool::Lease same = pool.acquire(10, 20, CV_32F);
+  EXPECT_EQ(same.mat().data, data);
+  EXPECT_EQ(pool.allocations(), 1u);
+  EXPECT_EQ(pool.cachedBytes(), 0u);
+
+  // Different dimensions or type never share a buffer
+  WorkspacePool::Lease other = pool.acquire(10, 20, CV_8U);
+  EXPECT_EQ(pool.allocations(), 2u);
+}
+
+TEST(WorkspacePoolTests, CapacityLimitsCachedBytes) {
+  WorkspacePool pool(100);
+  { WorkspacePool::Lease small = pool.acquire(10, 10, CV_8U); }
+  { WorkspacePool::Lease big = pool.acquire(10, 11, CV_8U); }
+  EXPECT_EQ(pool.cachedBytes(), 100u);
+  pool.clear();
+  EXPECT_EQ(pool.cachedBytes(), 0u);
+}
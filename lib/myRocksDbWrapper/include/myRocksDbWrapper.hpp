@@ -35,8 +35,33 @@ public:
      */
     explicit RocksDbWrapper(const std::string &pathDatabase);
 
+    /**
+     * @brief Constructor for a secondary (read-only follower) instance.
+     *
+     * Opens the database at pathDatabase as a RocksDB secondary instance. A secondary does not take the LOCK file,
+     * so it can coexist with the process that owns the primary and see its writes after catchUpWithPrimary().
+     *
+     * @param pathDatabase Path to the primary database.
+     * @param secondaryPath Directory where the secondary keeps its own info log and metadata.
+     */
+    RocksDbWrapper(const std::string &pathDatabase, const std::string &secondaryPath);
+
     ~RocksDbWrapper(); // Destructor
 
+    /**
+     * @brief Replays the primary's latest MANIFEST and WAL changes into this secondary instance.
+     *
+     * @note Only valid for instances created with the secondary constructor.
+     * @throws std::runtime_error if the instance is not a secondary or the catch up fails.
+     */
+    void catchUpWithPrimary();
+
+    /**
+     * @brief Check whether this wrapper was opened as a secondary instance.
+     * @return true if the instance is a secondary, false otherwise.
+     */
+    bool isSecondary() const { return m_secondary; };
+
     /**
      * @brief Put a key-value pair in the database.
      * @param key Key to put.
@@ -118,6 +143,7 @@ public:
     
 private:
     rocksdb::DB* m_database;  ///< Database instance.
+    bool m_secondary = false; ///< True when opened with OpenAsSecondary.
 };
 
 #endif // _ROCKS_DB_WRAPPER_HPP
@@ -27,11 +27,36 @@ RocksDbWrapper::RocksDbWrapper(const std::string &pathDatabase)
     }
 }
 
+RocksDbWrapper::RocksDbWrapper(const std::string &pathDatabase, const std::string &secondaryPath)
+    : m_secondary(true)
+{
+    rocksdb::Options options;
+    options.max_open_files = -1; // Required by secondary instances
+    rocksdb::Status status = rocksdb::DB::OpenAsSecondary(options, pathDatabase, secondaryPath, &m_database);
+    if (!status.ok())
+    {
+        throw std::runtime_error("Failed to open database as secondary due: " + status.ToString());
+    }
+}
+
 RocksDbWrapper::~RocksDbWrapper() {
     m_database->Close();
     delete m_database;
 }
 
+void RocksDbWrapper::catchUpWithPrimary()
+{
+    if (!m_secondary)
+    {
+        throw std::runtime_error("Catch up is only supported on secondary instances");
+    }
+    rocksdb::Status status = m_database->TryCatchUpWithPrimary();
+    if (!status.ok())
+    {
+        throw std::runtime_error("Failed to catch up with primary due: " + status.ToString());
+    }
+}
+
 void RocksDbWrapper::put(const std::string &key, const rocksdb::Slice &value)
 {
     rocksdb::Status status = m_database->Put(rocksdb::WriteOptions(), key, value);
@@ -5,7 +5,6 @@ pid_t pid_child;
 pid_t pid_parent;
 int authenticated = 0;
 char* ip_address = NULL;
-int zip_size_bytes = 0;
 
 int main(int argc, char* argv[])
 {
@@ -201,8 +200,10 @@ void receive_json(int sockfd)
         return;
     }
 
-    // Parse received JSON
-    cJSON* json = cJSON_Parse(buffer);
+    // Parse received JSON. A streamed result may follow it in the same read, past the end of the JSON
+    const char* json_end = buffer;
+    cJSON* json = cJSON_ParseWithLengthOpts(buffer, (size_t)bytes_received, &json_end, 0);
+    size_t pending_bytes = json != NULL ? (size_t)(buffer + bytes_received - json_end) : 0;
 
     // if (json == NULL)
     // {
@@ -263,9 +264,17 @@ void receive_json(int sockfd)
                     if (selected_image && cJSON_IsString(selected_image))
                     {
                         printf("You selected: %s\n", selected_image->valuestring);
+                        printf("Get a quick preview first? (y/n): ");
+                        int answer = getchar();
+                        if (answer != '\n')
+                        {
+                            while (getchar() != '\n')
+                                ; // consume the rest of the line
+                        }
                         cJSON* json_selection = cJSON_CreateObject();
                         cJSON_AddStringToObject(json_selection, "message", "image_selection");
                         cJSON_AddStringToObject(json_selection, "image", selected_image->valuestring);
+                        cJSON_AddBoolToObject(json_selection, "preview", answer == 'y' || answer == 'Y');
                         send_json(sockfd, json_selection);
                         cJSON_Delete(json_selection);
                     }
@@ -284,23 +293,27 @@ void receive_json(int sockfd)
                 printf("Error: Unable to retrieve image list from JSON.\n");
             }
         }
-        else if (strcmp(message_value, "file_size") == 0)
+        else if (strcmp(message_value, "zip_ready") == 0)
         {
-            cJSON* file_size = cJSON_GetObjectItem(json, "size");
-            if (file_size && cJSON_IsNumber(file_size))
+            printf("Server ready to send ZIP \n");
+            cJSON* preview = cJSON_GetObjectItem(json, "preview");
+            if (cJSON_IsTrue(preview))
             {
-                // Store the size of the zip file in global variable
-                zip_size_bytes = file_size->valueint;
+                receive_edge_map(sockfd, json_end, pending_bytes, SAVE_PREVIEW_EDGES_PATH);
+                printf("Select the image again and skip the preview to get the full resolution result\n");
             }
             else
             {
-                printf("Error: Unable to retrieve file size from JSON.\n");
+                receive_edge_map(sockfd, json_end, pending_bytes, SAVE_EDGES_PATH);
             }
         }
-        else if (strcmp(message_value, "zip_ready") == 0)
+        else if (strcmp(message_value, "error") == 0)
         {
-            printf("Server ready to send ZIP \n");
-            receive_zip(sockfd, "./cannyResult.zip");
+            cJSON* reason = cJSON_GetObjectItem(json, "reason");
+            if (reason && cJSON_IsString(reason))
+            {
+                printf("\n [+] Error from server: %s\n", reason->valuestring);
+            }
         }
         else if (strcmp(message_value, "alert") == 0)
         {
@@ -718,42 +731,219 @@ int do_connect(char* server, char* port)
     return sfd;
 }
 
-void receive_zip(int sockfd, const char* file_path)
+// Reads exactly size bytes, the pending ones first and then from the socket. Returns -1 if the connection ends before
+static int read_stream(int sockfd, const char** pending, size_t* pending_size, unsigned char* out, size_t size)
 {
-    // Open the file in binary write mode
-    FILE* file = fopen(file_path, "wb");
-    if (file == NULL)
+    size_t from_pending = *pending_size < size ? *pending_size : size;
+    memcpy(out, *pending, from_pending);
+    *pending += from_pending;
+    *pending_size -= from_pending;
+
+    for (size_t received = from_pending; received < size;)
     {
-        perror("Error opening file to write");
-        return;
+        ssize_t bytes_received = recv(sockfd, out + received, size - received, MSG_WAITALL);
+        if (bytes_received <= 0)
+        {
+            return -1;
+        }
+        received += (size_t)bytes_received;
+    }
+    return 0;
+}
+
+// Inflates a frame into the growing edge map buffer. Every frame may hold several gzip members or end in the middle
+// of one, the stream is reset at the end of every member
+static int inflate_frame(z_stream* stream, unsigned char* frame, size_t frame_size, unsigned char** data, size_t* size,
+                         size_t* capacity)
+{
+    stream->next_in = frame;
+    stream->avail_in = (uInt)frame_size;
+    while (stream->avail_in > 0)
+    {
+        if (*size == *capacity)
+        {
+            unsigned char* grown = realloc(*data, *capacity * 2);
+            if (grown == NULL)
+            {
+                return -1;
+            }
+            *data = grown;
+            *capacity *= 2;
+        }
+        stream->next_out = *data + *size;
+        stream->avail_out = (uInt)(*capacity - *size);
+        int status = inflate(stream, Z_NO_FLUSH);
+        *size = *capacity - stream->avail_out;
+        if (status == Z_STREAM_END)
+        {
+            inflateReset(stream);
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR)
+        {
+            return -1;
+        }
     }
+    return 0;
+}
 
-    printf("Receiving ZIP of size %d bytes...\n", zip_size_bytes);
+int receive_edge_map(int sockfd, const char* pending, size_t pending_size, const char* pbm_path)
+{
+    printf("Receiving the edge map...\n");
 
-    // Define size of the file to receive
-    ssize_t total_bytes_received = 0;
-    ssize_t max_bytes_to_receive = zip_size_bytes;
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK)
+    {
+        fprintf(stderr, "Error initializing the gzip decoder\n");
+        return -1;
+    }
 
-    // Receive data in chunks and write to the file
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_received;
-    while ((bytes_received = recv(sockfd, buffer, BUFFER_SIZE, 0)) > 0)
+    // Every frame is inflated as soon as it arrives, nothing is written to disk but the decoded image. After an
+    // error the rest of the frames are still read, so the next message starts where it should
+    size_t size = 0;
+    size_t capacity = BUFFER_SIZE;
+    unsigned char* data = malloc(capacity);
+    unsigned char* frame = malloc(EDGE_MAP_MAX_FRAME_BYTES);
+    int failed = data == NULL || frame == NULL;
+    unsigned char header[EDGE_MAP_FRAME_HEADER_BYTES];
+    for (;;)
     {
-        fwrite(buffer, sizeof(char), (size_t)bytes_received, file);
-        total_bytes_received += bytes_received;
-        if (total_bytes_received >= max_bytes_to_receive)
+        if (read_stream(sockfd, &pending, &pending_size, header, sizeof(header)) < 0)
         {
-            break; // Stop receiving data after reaching the expected size
+            fprintf(stderr, "The connection ended in the middle of the edge map\n");
+            failed = 1;
+            break;
+        }
+        size_t frame_size = (size_t)header[0] << 24 | (size_t)header[1] << 16 | (size_t)header[2] << 8 | header[3];
+        if (frame_size == 0)
+        {
+            break;
+        }
+        if (frame_size > EDGE_MAP_MAX_FRAME_BYTES)
+        {
+            fprintf(stderr, "Frame of %zu bytes out of the protocol\n", frame_size);
+            failed = 1;
+            break;
+        }
+        if (frame == NULL || read_stream(sockfd, &pending, &pending_size, frame, frame_size) < 0)
+        {
+            fprintf(stderr, "The connection ended in the middle of the edge map\n");
+            failed = 1;
+            break;
+        }
+        if (!failed && inflate_frame(&stream, frame, frame_size, &data, &size, &capacity) < 0)
+        {
+            fprintf(stderr, "Error inflating the received edge map\n");
+            failed = 1;
         }
     }
-    if (bytes_received < 0)
+    inflateEnd(&stream);
+    free(frame);
+
+    int result = failed ? -1 : decode_edge_map(data, size, pbm_path);
+    free(data);
+    return result;
+}
+
+static uint64_t read_little_endian(const unsigned char* data, int bytes)
+{
+    uint64_t value = 0;
+    for (int byte = bytes - 1; byte >= 0; byte--)
     {
-        perror("Error receiving data from server");
+        value = (value << 8) | data[byte];
     }
-    else
+    return value;
+}
+
+// Reads a LEB128 varint token, returns -1 when it runs past the end of the payload
+static int read_varint(const unsigned char** data, const unsigned char* end, uint64_t* value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && *data < end; shift += 7)
+    {
+        unsigned char byte = *(*data)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Expands the payload into the packed rows, returns -1 if it doesn't cover them exactly
+static int expand_edge_map(const unsigned char* payload, const unsigned char* end, int encoding, unsigned char* packed,
+                           size_t packed_size)
+{
+    if (encoding == EDGE_MAP_ENCODING_PACKED)
+    {
+        if ((size_t)(end - payload) != packed_size)
+        {
+            return -1;
+        }
+        memcpy(packed, payload, packed_size);
+        return 0;
+    }
+
+    size_t position = 0;
+    while (payload < end)
+    {
+        uint64_t token;
+        if (read_varint(&payload, end, &token) < 0)
+        {
+            return -1;
+        }
+        uint64_t count = token >> 1;
+        if (count > packed_size - position || ((token & 1) && count > (uint64_t)(end - payload)))
+        {
+            return -1;
+        }
+        if (token & 1)
+        {
+            memcpy(packed + position, payload, count);
+            payload += count;
+        }
+        else
+        {
+            memset(packed + position, 0, count);
+        }
+        position += count;
+    }
+    return position == packed_size ? 0 : -1;
+}
+
+int decode_edge_map(const unsigned char* data, size_t size, const char* pbm_path)
+{
+    if (size < EDGE_MAP_HEADER_BYTES || memcmp(data, "EDGM", 4) != 0 || data[4] != EDGE_MAP_VERSION)
     {
-        printf("Zip file received successfully\n");
+        fprintf(stderr, "The received data is not a supported edge map\n");
+        return -1;
+    }
+    uint32_t cols = (uint32_t)read_little_endian(data + 8, 4);
+    uint32_t rows = (uint32_t)read_little_endian(data + 12, 4);
+    uint64_t payload_bytes = read_little_endian(data + 16, 8);
+    size_t packed_size = ((size_t)cols + 7) / 8 * rows;
+    unsigned char* packed = payload_bytes <= size - EDGE_MAP_HEADER_BYTES ? malloc(packed_size) : NULL;
+    if (packed == NULL || expand_edge_map(data + EDGE_MAP_HEADER_BYTES, data + EDGE_MAP_HEADER_BYTES + payload_bytes,
+                                          data[5], packed, packed_size) < 0)
+    {
+        fprintf(stderr, "The received edge map is corrupt\n");
+        free(packed);
+        return -1;
     }
 
+    FILE* file = fopen(pbm_path, "wb");
+    if (file == NULL)
+    {
+        perror("Error opening file to write");
+        free(packed);
+        return -1;
+    }
+    fprintf(file, "P4\n%u %u\n", cols, rows);
+    fwrite(packed, 1, packed_size, file);
     fclose(file);
+    free(packed);
+
+    printf("Edge map of %ux%u saved in %s\n", cols, rows, pbm_path);
+    return 0;
 }
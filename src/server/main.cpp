@@ -7,13 +7,32 @@
 
 #define DEFAULT_PORT 5005
 
-void parse_command_line_arguments(int argc, char* argv[], int* tcp_port, int* udp_port)
+void parse_command_line_arguments(int argc, char* argv[], int* tcp_port, int* udp_port, ThreadAffinity* affinity)
 {
     int opt;
-    while ((opt = getopt(argc, argv, "p:")) != -1)
+    while ((opt = getopt(argc, argv, "p:a:")) != -1)
     {
         switch (opt)
         {
+        case 'a':
+            if (strcmp(optarg, "none") == 0)
+            {
+                *affinity = ThreadAffinity::None;
+            }
+            else if (strcmp(optarg, "node") == 0)
+            {
+                *affinity = ThreadAffinity::Node;
+            }
+            else if (strcmp(optarg, "core") == 0)
+            {
+                *affinity = ThreadAffinity::Core;
+            }
+            else
+            {
+                std::cout << "Invalid -a option. It should be 'none', 'node' or 'core'." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'p':
             if (strcmp(optarg, "tcp") == 0)
             {
@@ -46,7 +65,8 @@ void parse_command_line_arguments(int argc, char* argv[], int* tcp_port, int* ud
             }
             break;
         default:
-            std::cout << "Usage: " << argv[0] << " -p tcp <tcp_port> -p udp <udp_port>" << std::endl;
+            std::cout << "Usage: " << argv[0] << " -p tcp <tcp_port> -p udp <udp_port> [-a none|node|core]"
+                      << std::endl;
             exit(EXIT_FAILURE);
         }
     }
@@ -66,12 +86,15 @@ int main(int argc, char* argv[])
     int tcp_port = DEFAULT_PORT;
     int udp_port = DEFAULT_PORT;
 
-    parse_command_line_arguments(argc, argv, &tcp_port, &udp_port);
+    ThreadAffinity affinity = ThreadAffinity::None;
+
+    parse_command_line_arguments(argc, argv, &tcp_port, &udp_port, &affinity);
 
     std::cout << "TCP Port: " << tcp_port << std::endl;
     std::cout << "UDP Port: " << udp_port << std::endl;
 
     Server server(tcp_port, udp_port);
+    server.setCannyAffinity(affinity);
     server.start();
 
     return 0;
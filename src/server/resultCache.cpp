@@ -0,0 +1,168 @@
+#include "resultCache.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Temporary files are named after the result, then this, the pid of the writer and a counter
+const std::string TEMPORARY_SUFFIX = ".tmp";
+} // namespace
+
+ResultCache::ResultCache(const std::string& directory, const std::string& extension, uintmax_t capacityBytes)
+    : directory_(directory), extension_(extension), capacityBytes_(capacityBytes)
+{
+}
+
+std::string ResultCache::key(const std::string& inputPath, const std::string& parameters)
+{
+    struct stat fileStat;
+    if (stat(inputPath.c_str(), &fileStat) != 0)
+    {
+        return "";
+    }
+    const uintmax_t size = fileStat.st_size;
+    auto sameTime = [](const timespec& a, const timespec& b) { return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec; };
+
+    // Only a new or modified input is hashed again. Whole seconds aren't enough, an image replaced by one of the same
+    // size within a second would keep the old hash
+    auto it = hashes_.find(inputPath);
+    if (it == hashes_.end() || it->second.inode != fileStat.st_ino || it->second.size != size ||
+        !sameTime(it->second.modified, fileStat.st_mtim) || !sameTime(it->second.changed, fileStat.st_ctim))
+    {
+        std::string hash = Utils::hashFile(inputPath);
+        if (hash.empty())
+        {
+            return "";
+        }
+        it = hashes_.insert_or_assign(inputPath, HashedFile{fileStat.st_ino, size, fileStat.st_mtim, fileStat.st_ctim,
+                                                            hash}).first;
+    }
+    return it->second.hash + "_" + parameters;
+}
+
+std::string ResultCache::path(const std::string& key) const
+{
+    return directory_ + key + extension_;
+}
+
+bool ResultCache::lookup(const std::string& key)
+{
+    std::error_code error;
+    // The modification time is the last use
+    fs::last_write_time(path(key), fs::file_time_type::clock::now(), error);
+    return !error;
+}
+
+bool ResultCache::publish(const std::string& key, const Writer& writer)
+{
+    // Unique per process and per call, so concurrent writers of the same result don't share a temporary file
+    static std::atomic<unsigned> counter{0};
+    const std::string temporaryPath =
+        path(key) + TEMPORARY_SUFFIX + std::to_string(getpid()) + "_" + std::to_string(counter++);
+
+    std::error_code error;
+    if (!writer(temporaryPath))
+    {
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+    fs::rename(temporaryPath, path(key), error);
+    if (error)
+    {
+        std::cerr << "Error publishing " << path(key) << ": " << error.message() << std::endl;
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+
+    evict(key);
+    return true;
+}
+
+uintmax_t ResultCache::evict(const std::string& keep)
+{
+    struct Result
+    {
+        fs::path path;
+        uintmax_t size;
+        fs::file_time_type lastUse;
+    };
+
+    // The directory is the index, other processes may publish into it too
+    std::vector<Result> results;
+    uintmax_t totalBytes = 0;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(directory_, error))
+    {
+        const std::string name = entry.path().filename().string();
+        const size_t temporary = name.rfind(extension_ + TEMPORARY_SUFFIX);
+        if (temporary != std::string::npos)
+        {
+            // A writer that crashed never removes its temporary file, and it isn't counted against the budget
+            if (entry.is_regular_file(error) &&
+                isStaleTemporary(entry, name.substr(temporary + extension_.size() + TEMPORARY_SUFFIX.size())) &&
+                fs::remove(entry.path(), error))
+            {
+                std::cout << "Removed abandoned temporary result " << name << std::endl;
+            }
+            continue;
+        }
+        if (!entry.is_regular_file(error) || name.size() < extension_.size() ||
+            name.compare(name.size() - extension_.size(), extension_.size(), extension_) != 0)
+        {
+            continue;
+        }
+        Result result{entry.path(), entry.file_size(error), entry.last_write_time(error)};
+        if (!error)
+        {
+            totalBytes += result.size;
+            if (keep.empty() || entry.path() != fs::path(path(keep)))
+            {
+                results.push_back(result);
+            }
+        }
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const Result& a, const Result& b) { return a.lastUse < b.lastUse; });
+    for (const Result& result : results)
+    {
+        if (totalBytes <= capacityBytes_)
+        {
+            break;
+        }
+        if (fs::remove(result.path, error))
+        {
+            totalBytes -= result.size;
+            std::cout << "Result cache over budget, removed " << result.path.filename().string() << std::endl;
+        }
+    }
+    return totalBytes;
+}
+
+bool ResultCache::isStaleTemporary(const fs::directory_entry& entry, const std::string& suffix)
+{
+    std::error_code error;
+    const fs::file_time_type modified = entry.last_write_time(error);
+    if (!error && fs::file_time_type::clock::now() - modified > STALE_TEMPORARY_AGE)
+    {
+        return true;
+    }
+
+    // kill() with no signal only checks whether the process exists
+    char* end = nullptr;
+    const long pid = std::strtol(suffix.c_str(), &end, 10);
+    return end != suffix.c_str() && *end == '_' && pid > 0 && kill(static_cast<pid_t>(pid), 0) != 0 &&
+           errno == ESRCH;
+}
@@ -1,5 +1,10 @@
 #include "server.hpp"
 
+// ioprio_set() has no glibc wrapper nor constants
+constexpr int IOPRIO_WHO_PROCESS = 1;
+constexpr int IOPRIO_CLASS_IDLE = 3;
+constexpr int IOPRIO_CLASS_SHIFT = 13;
+
 // Initialize static members
 bool Server::SERVER_RUNNING = true;
 Server* Server::serverInstance = nullptr;
@@ -20,6 +25,124 @@ Server::~Server()
     delete emergNotifIdGen;
 }
 
+std::string Server::cannyResultParameters(const CannyParameters& parameters)
+{
+    std::string name = "s" + std::to_string(parameters.sigma) + "_k" + std::to_string(parameters.kernelSize) + "_t" +
+                       std::to_string(parameters.lowThreshold) + "_" + std::to_string(parameters.highThreshold) + "_" +
+                       parameters.thresholdMode;
+    if (parameters.previewSize > 0)
+    {
+        name += "_preview" + std::to_string(parameters.previewSize);
+    }
+    return name;
+}
+
+bool Server::computeCannyResult(const std::string& imagePath, const std::string& resultKey,
+                                const CannyParameters& parameters, const Utils::ChunkWriter& stream,
+                                bool cacheSuppression)
+{
+    ImageFileOperations imageFileOperations;
+    EdgeDetection edgeDetection(parameters.lowThreshold, parameters.highThreshold, parameters.sigma,
+                                parameters.kernelSize);
+    edgeDetection.setThreadAffinity(cannyAffinity_);
+    if (cacheSuppression)
+    {
+        edgeDetection.setSuppressionCache(&SuppressionCache::instance());
+    }
+    if (parameters.thresholdMode == "otsu")
+    {
+        edgeDetection.setThresholdMode(ThresholdMode::Otsu);
+    }
+    else if (parameters.thresholdMode == "percentile")
+    {
+        edgeDetection.setThresholdMode(ThresholdMode::Percentile);
+    }
+
+    // PGM and raw images are read into a pooled buffer rather than decoded, the buffer lives until the result is
+    // encoded. They aren't mapped: clients and operators may overwrite an image in place while it is processed, and
+    // a mapped file truncated under the pipeline kills the process with SIGBUS
+    MappedImage mapped;
+    cv::Mat image = imageFileOperations.openImage(imagePath, mapped, MappedImage::Access::Read);
+
+    // The full resolution result buffer is reused across requests of the same image size
+    WorkspacePool::Lease edges;
+    cv::Mat result;
+
+    const bool preview = parameters.previewSize > 0;
+    auto start_time = std::chrono::steady_clock::now();
+    try
+    {
+        if (preview)
+        {
+            edgeDetection.previewEdgeDetection(image, result, parameters.previewSize);
+        }
+        else
+        {
+            edges = WorkspacePool::instance().acquire(image.rows, image.cols, CV_8U);
+            edgeDetection.cannyEdgeDetection(image, edges.mat());
+            result = edges.mat();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Canny edge filter of " << imagePath << " failed: " << e.what() << std::endl;
+        return false;
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    std::cout << "[TIMER] Canny edge filter" << (preview ? " preview: " : ": ") << duration.count() << " seconds\n";
+
+    // The result goes straight from memory to the zip, nothing is written in between. The edge map is bit-packed
+    // rather than a PNG, so the gzip doesn't deflate already deflated data. It is published atomically, no reader
+    // ever sees a partly written result. The whole map is encoded before the first member is compressed: the codec
+    // header records the encoding and payload size, which are only known once every block is encoded
+    start_time = std::chrono::steady_clock::now();
+    std::vector<uchar> encodedEdges;
+    EdgeMapCodec::encode(result, encodedEdges);
+    duration = std::chrono::steady_clock::now() - start_time;
+    std::cout << "[TIMER] Edge map encoding: " << duration.count() << " seconds\n";
+    return resultCache->publish(resultKey, [&encodedEdges, &stream](const std::string& path) {
+        std::ofstream file(path, std::ios::binary);
+        bool fileOk = file.is_open();
+        bool streamOk = static_cast<bool>(stream);
+        if (!fileOk)
+        {
+            std::cerr << "Error creating compressed file: " << path << std::endl;
+        }
+
+        // Every member is teed to the cache file and the stream, compression only stops once both are gone
+        bool compressed = Utils::gzipChunks(
+            encodedEdges.data(), encodedEdges.size(), [&](const unsigned char* data, size_t size) {
+                if (fileOk)
+                {
+                    fileOk = static_cast<bool>(file.write(reinterpret_cast<const char*>(data), size));
+                }
+                if (streamOk)
+                {
+                    streamOk = stream(data, size);
+                }
+                return fileOk || streamOk;
+            });
+        file.close();
+        if (!fileOk || file.fail())
+        {
+            std::cerr << "Error writing compressed file: " << path << std::endl;
+            return false;
+        }
+        return compressed;
+    });
+}
+
+void Server::setCannyAffinity(ThreadAffinity affinity)
+{
+    cannyAffinity_ = affinity;
+
+    // Shows the placement the Canny threads will get, so a build or machine that can't honour it is noticed
+    static const char* const names[] = {"none", "node", "core"};
+    std::cout << "Canny threads: " << omp_get_max_threads() << " over " << NumaPlacement::topology().size()
+              << " NUMA node(s), affinity " << names[static_cast<int>(affinity)] << std::endl;
+}
+
 void Server::start()
 {
 
@@ -30,6 +153,8 @@ void Server::start()
     Utils::createDirectoriesIfNotExists(IMAGE_PATH);
     Utils::createDirectoriesIfNotExists(ZIP_PATH);
     Utils::createDirectoriesIfNotExists(CONVERTION_OUT_PATH);
+    resultCache = std::make_unique<ResultCache>(ZIP_PATH, CANNY_RESULT_EXTENSION, CANNY_CACHE_CAPACITY);
+    resultCache->evict();
 
     int lastSuppliesId = getLastId(LAST_SUPPLIES_ID_KEY);
     int lastAlertsId = getLastId(LAST_ALERT_ID_KEY);
@@ -41,6 +166,7 @@ void Server::start()
     createInfectionAlertsProcess();
     createPowerOutageAlertsProcess();
     createRestListenerProcess();
+    createPrecomputeProcess();
 
     // Write initial event to RocksDB entry
     try
@@ -390,54 +516,99 @@ bool Server::checkTcpClientsMsgs(int client_fd)
                     std::string selected_image_name = received_json["image"];
                     std::cout << "Client selected image: " << selected_image_name << std::endl;
 
-                    // Obtain the base name of the image without the extension
-                    std::string imageWithoutExtension;
-                    std::string::size_type pos = selected_image_name.find_last_of('.');
-                    if (pos != std::string::npos)
+                    // The blur can be tuned per request, unsupported kernel sizes fall back to the default one
+                    float sigma = received_json.value("sigma", CANNY_DEFAULT_SIGMA);
+                    int kernelSize = received_json.value("kernel_size", CANNY_DEFAULT_KERNEL_SIZE);
+                    if (kernelSize != 3 && kernelSize != 5 && kernelSize != 7)
                     {
-                        imageWithoutExtension = selected_image_name.substr(0, pos);
+                        std::cerr << "Unsupported kernel size " << kernelSize << ", using "
+                                  << CANNY_DEFAULT_KERNEL_SIZE << std::endl;
+                        kernelSize = CANNY_DEFAULT_KERNEL_SIZE;
                     }
 
-                    // Check if a .zip file already exists with the name of the image in ZIP_PATH
-                    std::string ZipFileName = imageWithoutExtension + ".zip";
-                    bool zipExists = Utils::fileExists(ZIP_PATH, ZipFileName);
-                    std::string zipCompletePath = ZIP_PATH + ZipFileName;
-                    if (!zipExists)
+                    // Re-tuning the thresholds of an image already processed only runs the hysteresis, the
+                    // suppressed map is kept in the SuppressionCache of the process
+                    float lowThreshold = received_json.value("low_threshold", CANNY_DEFAULT_LOW_THRESHOLD);
+                    float highThreshold = received_json.value("high_threshold", CANNY_DEFAULT_HIGH_THRESHOLD);
+                    if (lowThreshold < 0 || highThreshold < lowThreshold)
                     {
-                        // If the .zip file doesn't exist, perform edge detection and compression of the image
-                        std::string image_path_with_name = IMAGE_PATH + selected_image_name;
-                        EdgeDetection edgeDetection(40.0, 80.0, 1.0);
-
-                        auto start_time = std::chrono::steady_clock::now();
-                        edgeDetection.cannyEdgeDetection(image_path_with_name, CONVERTION_OUT_PATH);
-                        auto end_time = std::chrono::steady_clock::now();
-                        std::chrono::duration<double> duration = end_time - start_time;
-                        std::cout << "[TIMER] Canny edge filter: " << duration.count() << " seconds\n";
-
-                        std::string imageToCompress = CONVERTION_OUT_PATH + CANNY_RESULT;
-                        Utils::compressImg(imageToCompress, zipCompletePath);
+                        std::cerr << "Invalid thresholds " << lowThreshold << ", " << highThreshold
+                                  << ", using the default ones" << std::endl;
+                        lowThreshold = CANNY_DEFAULT_LOW_THRESHOLD;
+                        highThreshold = CANNY_DEFAULT_HIGH_THRESHOLD;
                     }
-                    else
+
+                    // Thresholds can be derived from every image instead of the fixed ones
+                    std::string thresholdMode = received_json.value("threshold_mode", std::string("fixed"));
+                    if (thresholdMode != "fixed" && thresholdMode != "otsu" && thresholdMode != "percentile")
                     {
-                        std::cout
-                            << "A .zip file already exists for the selected image. We'll use this one to save some time"
-                            << std::endl;
+                        std::cerr << "Unsupported threshold mode " << thresholdMode << ", using fixed" << std::endl;
+                        thresholdMode = "fixed";
                     }
 
-                    // Inform the client about the size of the .zip file
-                    int fileSize = 0;
-                    fileSize = Utils::getFileSize(zipCompletePath);
-                    json fileSizeMessage;
-                    fileSizeMessage["message"] = "file_size";
-                    fileSizeMessage["size"] = fileSize;
-                    sendJsonToTcpClient(client_fd, fileSizeMessage);
+                    // A preview runs on a reduced copy of the image, the full resolution is requested separately
+                    bool preview = received_json.value("preview", false);
+                    int previewSize = std::max(received_json.value("preview_size", PREVIEW_MAX_SIDE), 1);
+
+                    CannyParameters parameters{sigma, kernelSize, lowThreshold, highThreshold, thresholdMode,
+                                               preview ? previewSize : 0};
 
-                    // Inform the client that the .zip file is ready to be sent
+                    // Results are named after the contents of the image and every parameter, so an image replaced
+                    // under the same name or processed with other parameters never reuses a stale result
+                    std::string image_path_with_name = IMAGE_PATH + selected_image_name;
+                    std::string resultKey = resultCache->key(image_path_with_name, cannyResultParameters(parameters));
+                    if (resultKey.empty())
+                    {
+                        std::cerr << "Can not read the selected image " << image_path_with_name << std::endl;
+                        json error;
+                        error["message"] = "error";
+                        error["reason"] = "Can not read the selected image " + selected_image_name;
+                        sendJsonToTcpClient(client_fd, error);
+                        return true;
+                    }
+                    // The result is sent as a stream of frames, its size isn't known until the last one. The
+                    // announcement goes right before the first frame, an image that fails before it gets an error
                     json zipMessageAnouncement;
                     zipMessageAnouncement["message"] = "zip_ready";
-                    sendJsonToTcpClient(client_fd, zipMessageAnouncement);
-                    sleep(1); // Wait a bit so the client can prepare to receive the file
-                    sendFileToClient(client_fd, ZIP_PATH + ZipFileName);
+                    zipMessageAnouncement["preview"] = preview;
+                    if (resultCache->lookup(resultKey))
+                    {
+                        std::cout << "The result for the selected image and parameters is cached. We'll use it to save "
+                                     "some time"
+                                  << std::endl;
+                        sendJsonToTcpClient(client_fd, zipMessageAnouncement);
+                        sendFileToClient(client_fd, resultCache->path(resultKey));
+                        return true;
+                    }
+
+                    // Otherwise every compressed chunk goes to the client while the rest are still compressed
+                    bool announced = false;
+                    bool published = computeCannyResult(
+                        image_path_with_name, resultKey, parameters,
+                        [this, client_fd, &announced, &zipMessageAnouncement](const unsigned char* data, size_t size) {
+                            if (!announced)
+                            {
+                                sendJsonToTcpClient(client_fd, zipMessageAnouncement);
+                                announced = true;
+                            }
+                            return sendFrameToClient(client_fd, data, size);
+                        });
+                    if (announced)
+                    {
+                        sendFrameToClient(client_fd, nullptr, 0);
+                    }
+                    if (!published)
+                    {
+                        std::cerr << "Error processing " << selected_image_name << std::endl;
+                        // Once announced the client is reading frames and the empty one already ended the stream
+                        if (!announced)
+                        {
+                            json error;
+                            error["message"] = "error";
+                            error["reason"] = "Error processing " + selected_image_name;
+                            sendJsonToTcpClient(client_fd, error);
+                        }
+                    }
                 }
                 else
                 {
@@ -841,6 +1012,10 @@ void Server::sigintHandler(int signal)
         {
             kill(serverInstance->restListener, SIGTERM);
         }
+        if (serverInstance->precomputePid > 0)
+        {
+            kill(serverInstance->precomputePid, SIGTERM);
+        }
     }
 }
 
@@ -1171,6 +1346,16 @@ void Server::createRestListenerProcess()
             this->handleRestSupplies(req, res);
         };
 
+        // Open the secondary instance before serving, so the first request doesn't pay for it
+        try
+        {
+            getRestDatabase();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error opening REST secondary database: " << e.what() << std::endl;
+        }
+
         rest_api.Get("/alerts", alerts_handler);
         rest_api.Get("/supplies", supplies_handler);
         rest_api.listen("0.0.0.0", REST_API_PORT);
@@ -1181,6 +1366,111 @@ void Server::createRestListenerProcess()
     }
 }
 
+void Server::createPrecomputeProcess()
+{
+    // Forked before any request runs an OpenMP region, the child starts its own thread team
+    precomputePid = fork();
+    if (precomputePid < 0)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    else if (precomputePid == 0)
+    {
+        Utils::redirectOutputToParent(STDOUT_FILENO);
+        std::cout << "PID Canny precomputation: " << getpid() << std::endl;
+
+        // Only run on cores and use the disk when nothing else wants them, the threads inherit the policy
+        struct sched_param idleParam = {};
+        if (sched_setscheduler(0, SCHED_IDLE, &idleParam) != 0)
+        {
+            setpriority(PRIO_PROCESS, 0, 19);
+        }
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+
+        int inotifyFd = inotify_init1(IN_CLOEXEC);
+        if (inotifyFd < 0 || inotify_add_watch(inotifyFd, IMAGE_PATH.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            perror("inotify");
+            exit(EXIT_FAILURE);
+        }
+
+        // Hidden files are usually partial copies, they are picked up when renamed
+        std::deque<std::string> queue;
+        std::set<std::string> queued;
+        auto enqueue = [&](const std::string& name) {
+            if (!name.empty() && name[0] != '.' && queued.insert(name).second)
+            {
+                queue.push_back(name);
+            }
+        };
+        // Watch before listing, so an image arriving in between is not missed
+        for (const auto& name : Utils::findAvailableImages(IMAGE_PATH))
+        {
+            enqueue(name);
+        }
+
+        alignas(struct inotify_event) char buffer[BUFFER_SIZE * 4];
+        while (SERVER_RUNNING)
+        {
+            // Wait for events only when there is nothing left to do, otherwise just drain them
+            struct pollfd pollFd = {inotifyFd, POLLIN, 0};
+            if (poll(&pollFd, 1, queue.empty() ? -1 : 0) > 0)
+            {
+                ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+                for (char* position = buffer; length > 0 && position < buffer + length;)
+                {
+                    const auto* event = reinterpret_cast<const struct inotify_event*>(position);
+                    if (event->len > 0 && (event->mask & IN_ISDIR) == 0)
+                    {
+                        enqueue(event->name);
+                    }
+                    position += sizeof(struct inotify_event) + event->len;
+                }
+            }
+
+            if (!queue.empty())
+            {
+                std::string imageName = queue.front();
+                queue.pop_front();
+                queued.erase(imageName);
+                precomputeCannyResults(imageName);
+            }
+        }
+        close(inotifyFd);
+        exit(EXIT_SUCCESS);
+    }
+    else
+    {
+        return;
+    }
+}
+
+void Server::precomputeCannyResults(const std::string& imageName)
+{
+    // The preview first, it is what a client asks for first and it takes a fraction of the time
+    for (int previewSize : {PREVIEW_MAX_SIDE, 0})
+    {
+        CannyParameters parameters{CANNY_DEFAULT_SIGMA, CANNY_DEFAULT_KERNEL_SIZE, CANNY_DEFAULT_LOW_THRESHOLD,
+                                   CANNY_DEFAULT_HIGH_THRESHOLD, "fixed", previewSize};
+        std::string resultKey = resultCache->key(IMAGE_PATH + imageName, cannyResultParameters(parameters));
+        if (resultKey.empty())
+        {
+            return; // Removed meanwhile
+        }
+
+        // Existing results are not looked up, precomputing is not a use
+        if (!fs::exists(resultCache->path(resultKey)))
+        {
+            std::cout << "Precomputing " << (previewSize > 0 ? "the preview of " : "") << imageName << std::endl;
+            computeCannyResult(IMAGE_PATH + imageName, resultKey, parameters, nullptr, false);
+        }
+    }
+
+    // The child idles until the next image arrives, which is likely of another size: it keeps none of the buffers
+    WorkspacePool::instance().clear();
+}
+
 void Server::handleRestAlerts(const httplib::Request& req, httplib::Response& res)
 {
     std::string remote_ip = req.remote_addr;
@@ -1189,7 +1479,19 @@ void Server::handleRestAlerts(const httplib::Request& req, httplib::Response& re
     std::cout << "Received request from " << remote_ip << " for alerts data" << std::endl;
     Utils::logEvent("Received request through API for supplies data from " + remote_ip);
 
-    RocksDbWrapper dbWrapper(DB_NAME);
+    RocksDbWrapper* restDb = nullptr;
+    try
+    {
+        restDb = &getRestDatabase();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error accessing REST database: " << e.what() << std::endl;
+        res.status = 500;
+        res.set_content(R"({"code":"500","message":"Bad Server"})", "application/json");
+        return;
+    }
+    RocksDbWrapper& dbWrapper = *restDb;
 
     if (req.params.size() > 1 || (req.params.size() == 1 && req.params.begin()->first != "id"))
     {
@@ -1245,7 +1547,19 @@ void Server::handleRestSupplies(const httplib::Request& req, httplib::Response&
     std::cout << "Received request from " << remote_ip << " for supplies data" << std::endl;
     Utils::logEvent("Received request through API for supplies data from " + remote_ip);
 
-    RocksDbWrapper dbWrapper(DB_NAME);
+    RocksDbWrapper* restDb = nullptr;
+    try
+    {
+        restDb = &getRestDatabase();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error accessing REST database: " << e.what() << std::endl;
+        res.status = 500;
+        res.set_content(R"({"code":"500","message":"Bad Server"})", "application/json");
+        return;
+    }
+    RocksDbWrapper& dbWrapper = *restDb;
 
     if (req.params.size() > 1 || (req.params.size() == 1 && req.params.begin()->first != "id"))
     {
@@ -1325,30 +1639,89 @@ void Server::handleRestSupplies(const httplib::Request& req, httplib::Response&
     }
 }
 
-void Server::sendFileToClient(int client_fd, const std::string& file_path)
+RocksDbWrapper& Server::getRestDatabase()
+{
+    std::lock_guard<std::mutex> lock(restDbMutex);
+    auto now = std::chrono::steady_clock::now();
+    if (!restDbWrapper)
+    {
+        restDbWrapper = std::make_unique<RocksDbWrapper>(DB_NAME, DB_SECONDARY_NAME);
+        restDbLastCatchUp = now;
+    }
+    else if (now - restDbLastCatchUp >= REST_CATCH_UP_INTERVAL)
+    {
+        try
+        {
+            restDbWrapper->catchUpWithPrimary();
+            restDbLastCatchUp = now;
+        }
+        catch (const std::exception& e)
+        {
+            // Keep serving the last consistent view, next request will retry
+            std::cerr << "Error catching up REST database with primary: " << e.what() << std::endl;
+        }
+    }
+    return *restDbWrapper;
+}
+
+bool Server::sendFileToClient(int client_fd, const std::string& file_path)
 {
     // Open the file in binary mode
     std::ifstream file(file_path, std::ios::binary);
     if (!file.is_open())
     {
         std::cerr << "Error: Could not open file " << file_path << std::endl;
-        return;
+        sendFrameToClient(client_fd, nullptr, 0);
+        return false;
+    }
+
+    // Send the file a chunk at a time, so only one chunk is ever in memory
+    std::vector<unsigned char> buffer(COMPRESS_CHUNK_BYTES);
+    while (file)
+    {
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+        if (file.gcount() > 0 && !sendFrameToClient(client_fd, buffer.data(), file.gcount()))
+        {
+            std::cerr << "Error: Failed to send file " << file_path << " to client" << std::endl;
+            return false;
+        }
+    }
+    bool complete = file.eof();
+    if (!complete)
+    {
+        std::cerr << "Error: Could not read file " << file_path << std::endl;
     }
-    // Read the file content into a buffer
-    std::string buffer;
-    file.seekg(0, std::ios::end);
-    buffer.resize(file.tellg());
-    file.seekg(0, std::ios::beg);
-    file.read(&buffer[0], buffer.size());
+    return sendFrameToClient(client_fd, nullptr, 0) && complete;
+}
 
-    // Send the file content through the socket
-    if (send(client_fd, buffer.data(), buffer.size(), 0) < 0)
+bool Server::sendFrameToClient(int client_fd, const unsigned char* data, size_t size)
+{
+    unsigned char header[CANNY_FRAME_HEADER_BYTES];
+    for (size_t byte = 0; byte < CANNY_FRAME_HEADER_BYTES; byte++)
     {
-        std::cerr << "Error: Failed to send file " << file_path << " to client" << std::endl;
+        header[byte] = static_cast<unsigned char>(size >> (8 * (CANNY_FRAME_HEADER_BYTES - 1 - byte)));
     }
 
-    // Close the file
-    file.close();
+    // A client closing the connection must not raise SIGPIPE in the server
+    auto sendAll = [client_fd](const unsigned char* bytes, size_t remaining) {
+        while (remaining > 0)
+        {
+            ssize_t sent = send(client_fd, bytes, remaining, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent <= 0)
+            {
+                perror("Error sending a frame to client");
+                return false;
+            }
+            bytes += sent;
+            remaining -= sent;
+        }
+        return true;
+    };
+    return sendAll(header, CANNY_FRAME_HEADER_BYTES) && sendAll(data, size);
 }
 
 int Server::getLastId(const std::string& key)
@@ -1,4 +1,11 @@
 #include "utils.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -111,6 +118,57 @@ int getFileSize(const std::string& filePath)
     return fileStat.st_size;
 }
 
+std::string hashFile(const std::string& filePath)
+{
+    constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+    constexpr size_t CHUNK_BYTES = 1 << 20; // A multiple of the 32 bytes of the four lanes
+    auto mix = [](uint64_t hash, uint64_t value) {
+        hash = (hash ^ value) * MULTIPLIER;
+        return hash ^ (hash >> 29);
+    };
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file)
+    {
+        return "";
+    }
+
+    std::vector<char> buffer(CHUNK_BYTES);
+    uint64_t lanes[4] = {0, 1, 2, 3};
+    uint64_t tail = 0;
+    uint64_t size = 0;
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        const size_t bytes = file.gcount();
+        size += bytes;
+        size_t position = 0;
+        for (; position + 32 <= bytes; position += 32)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                uint64_t word;
+                std::memcpy(&word, buffer.data() + position + 8 * lane, sizeof(word));
+                lanes[lane] = mix(lanes[lane], word);
+            }
+        }
+        // Only the last chunk has a tail
+        for (; position < bytes; ++position)
+        {
+            tail = mix(tail, static_cast<unsigned char>(buffer[position]));
+        }
+    }
+    if (file.bad())
+    {
+        return "";
+    }
+
+    const uint64_t hash = mix(mix(mix(mix(mix(lanes[0], lanes[1]), lanes[2]), lanes[3]), tail), size);
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
 void deleteDirectory(const std::string& path)
 {
     if (fs::exists(path)) // Check if directory exists
@@ -243,12 +301,17 @@ bool compressImg(const std::string& imagePath, const std::string& zipPath)
     inputFile.seekg(0, std::ios::end);
     size_t fileSize = inputFile.tellg();
     inputFile.seekg(0, std::ios::beg);
-    std::vector<char> buffer(fileSize);
-    inputFile.read(buffer.data(), fileSize);
+    std::vector<unsigned char> buffer(fileSize);
+    inputFile.read(reinterpret_cast<char*>(buffer.data()), fileSize);
     inputFile.close();
 
+    return compressImg(buffer, zipPath);
+}
+
+bool compressImg(const std::vector<unsigned char>& imageData, const std::string& zipPath)
+{
     // Open the zip file
-    gzFile zipFile = gzopen(zipPath.c_str(), "wb");
+    std::ofstream zipFile(zipPath, std::ios::binary);
     if (!zipFile)
     {
         std::cerr << "Error opening ZIP file" << std::endl;
@@ -256,15 +319,18 @@ bool compressImg(const std::string& imagePath, const std::string& zipPath)
     }
 
     // Compress the image buffer and write to the zip file
-    if (gzwrite(zipFile, buffer.data(), buffer.size()) != buffer.size())
+    if (!gzipChunks(imageData.data(), imageData.size(), [&zipFile](const unsigned char* data, size_t size) {
+            zipFile.write(reinterpret_cast<const char*>(data), size);
+            return static_cast<bool>(zipFile);
+        }))
     {
         std::cerr << "Error writing compressed data to ZIP file" << std::endl;
-        gzclose(zipFile);
         return false;
     }
 
     // Close the zip file
-    if (gzclose(zipFile) != Z_OK)
+    zipFile.close();
+    if (!zipFile)
     {
         std::cerr << "Error closing ZIP file" << std::endl;
         return false;
@@ -272,4 +338,151 @@ bool compressImg(const std::string& imagePath, const std::string& zipPath)
 
     return true;
 }
+
+namespace
+{
+// Compresses a chunk into a complete gzip member
+bool gzipMember(const unsigned char* data, size_t size, std::vector<unsigned char>& member)
+{
+    z_stream stream = {};
+    // 16 added to the window bits selects the gzip wrapper
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    member.resize(deflateBound(&stream, size));
+    stream.next_in = const_cast<unsigned char*>(data);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = member.data();
+    stream.avail_out = static_cast<uInt>(member.size());
+    const bool finished = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    member.resize(stream.total_out);
+    deflateEnd(&stream);
+    return finished;
+}
+
+// Threads compressing the chunks of every gzipChunks() call, started once per process instead of once per call. A
+// forked child has none of the threads of its parent and starts its own. Pools are never destroyed: the workers wait
+// for tasks until the process exits, and a child must not join threads of its parent
+class CompressionWorkers
+{
+  public:
+    static CompressionWorkers& instance()
+    {
+        static std::mutex mutex;
+        static CompressionWorkers* workers = nullptr;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (workers == nullptr || workers->owner_ != getpid())
+        {
+            workers = new CompressionWorkers(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        return *workers;
+    }
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(threads_.size());
+    }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        available_.notify_one();
+    }
+
+  private:
+    explicit CompressionWorkers(unsigned threads) : owner_(getpid())
+    {
+        for (unsigned thread = 0; thread < threads; ++thread)
+        {
+            threads_.emplace_back([this] { work(); });
+        }
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                available_.wait(lock, [this] { return !tasks_.empty(); });
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    pid_t owner_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+};
+} // namespace
+
+bool gzipChunks(const unsigned char* data, size_t size, const ChunkWriter& write, unsigned threads)
+{
+    const size_t chunks = std::max<size_t>(1, (size + COMPRESS_CHUNK_BYTES - 1) / COMPRESS_CHUNK_BYTES);
+    CompressionWorkers& workers = CompressionWorkers::instance();
+    if (threads == 0)
+    {
+        threads = workers.size();
+    }
+    // A small result only keeps as many workers busy as it has chunks
+    threads = static_cast<unsigned>(std::min<size_t>({threads, workers.size(), chunks}));
+    const size_t window = 2 * threads; // Chunks compressed ahead of the writes, at most
+
+    std::vector<std::vector<unsigned char>> members(chunks);
+    std::vector<bool> compressed(chunks, false);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t nextChunk = 0;
+    size_t written = 0;
+    size_t running = 0;
+    bool failed = false;
+
+    auto compressChunk = [&](size_t chunk) {
+        const size_t offset = chunk * COMPRESS_CHUNK_BYTES;
+        std::vector<unsigned char> member;
+        const bool succeeded = gzipMember(data + offset, std::min<size_t>(COMPRESS_CHUNK_BYTES, size - offset), member);
+        std::lock_guard<std::mutex> lock(mutex);
+        failed |= !succeeded;
+        members[chunk] = std::move(member);
+        compressed[chunk] = true;
+        running--;
+        // Under the lock, the call may return as soon as the last chunk is done
+        changed.notify_all();
+    };
+
+    // The members are written in order as they complete
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!failed && written < chunks)
+    {
+        while (nextChunk < chunks && running < threads && nextChunk < written + window)
+        {
+            running++;
+            workers.submit([&compressChunk, chunk = nextChunk++] { compressChunk(chunk); });
+        }
+        changed.wait(lock, [&] { return failed || compressed[written]; });
+        if (failed)
+        {
+            break;
+        }
+        std::vector<unsigned char> member = std::move(members[written]);
+        lock.unlock();
+        const bool succeeded = write(member.data(), member.size());
+        lock.lock();
+        failed |= !succeeded;
+        written++;
+    }
+
+    // The chunks still compressing use the state of this call
+    changed.wait(lock, [&] { return running == 0; });
+    return !failed;
+}
 } // namespace Utils
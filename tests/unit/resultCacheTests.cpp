@@ -0,0 +1,145 @@
+#include "resultCache.hpp"
+#include "utils.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+class ResultCacheTest : public ::testing::Test
+{
+  protected:
+    const std::string directory = "/tmp/result_cache_test/";
+    const std::string image = "/tmp/result_cache_test_image.bin";
+
+    void SetUp() override
+    {
+        fs::remove_all(directory);
+        fs::create_directories(directory);
+        writeFile(image, "image contents");
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(directory);
+        fs::remove(image);
+    }
+
+    static void writeFile(const std::string& path, const std::string& contents)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << contents;
+    }
+
+    static ResultCache::Writer writerOf(const std::string& contents)
+    {
+        return [contents](const std::string& path) {
+            writeFile(path, contents);
+            return true;
+        };
+    }
+};
+
+TEST(HashFileTest, HashesContents)
+{
+    const std::string path = "/tmp/hash_file_test.bin";
+    std::ofstream(path, std::ios::binary) << std::string(100000, 'a');
+    const std::string hash = Utils::hashFile(path);
+    EXPECT_EQ(hash.size(), 16u);
+    EXPECT_EQ(Utils::hashFile(path), hash);
+
+    std::ofstream(path, std::ios::binary) << std::string(99999, 'a') << 'b';
+    EXPECT_NE(Utils::hashFile(path), hash);
+
+    fs::remove(path);
+    EXPECT_TRUE(Utils::hashFile(path).empty());
+}
+
+TEST_F(ResultCacheTest, KeyFollowsContentsAndParameters)
+{
+    ResultCache cache(directory, ".res", 1024);
+    const std::string key = cache.key(image, "s1_k3");
+    EXPECT_FALSE(key.empty());
+    EXPECT_EQ(cache.key(image, "s1_k3"), key);
+    EXPECT_NE(cache.key(image, "s2_k3"), key);
+
+    // An image replaced under the same name gets another key
+    writeFile(image, "other image contents");
+    const std::string other = cache.key(image, "s1_k3");
+    EXPECT_NE(other, key);
+
+    // Even right away and with the same size, the modification time alone would still be the same second
+    writeFile(image, "other image CONTENTS");
+    EXPECT_NE(cache.key(image, "s1_k3"), other);
+
+    EXPECT_TRUE(cache.key("/tmp/result_cache_test_missing.bin", "s1_k3").empty());
+}
+
+TEST_F(ResultCacheTest, PublishesAtomically)
+{
+    ResultCache cache(directory, ".res", 1024);
+    const std::string key = cache.key(image, "p");
+    EXPECT_FALSE(cache.lookup(key));
+
+    EXPECT_TRUE(cache.publish(key, writerOf("result")));
+    EXPECT_TRUE(cache.lookup(key));
+    EXPECT_EQ(Utils::getFileSize(cache.path(key)), 6);
+
+    // A failed write publishes nothing and leaves no temporary file
+    const std::string other = cache.key(image, "q");
+    EXPECT_FALSE(cache.publish(other, [](const std::string& path) {
+        writeFile(path, "partial");
+        return false;
+    }));
+    EXPECT_FALSE(cache.lookup(other));
+    EXPECT_EQ(std::distance(fs::directory_iterator(directory), fs::directory_iterator()), 1);
+}
+
+TEST_F(ResultCacheTest, EvictsLeastRecentlyUsed)
+{
+    ResultCache cache(directory, ".res", 25);
+    const std::string first = cache.key(image, "1");
+    const std::string second = cache.key(image, "2");
+    const std::string third = cache.key(image, "3");
+    writeFile(directory + "unrelated.txt", std::string(100, 'x'));
+
+    ASSERT_TRUE(cache.publish(first, writerOf(std::string(10, 'a'))));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache.publish(second, writerOf(std::string(10, 'b'))));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // Using the first one makes the second the least recently used
+    EXPECT_TRUE(cache.lookup(first));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache.publish(third, writerOf(std::string(10, 'c'))));
+
+    EXPECT_TRUE(cache.lookup(first));
+    EXPECT_FALSE(cache.lookup(second));
+    EXPECT_TRUE(cache.lookup(third));
+    EXPECT_TRUE(fs::exists(directory + "unrelated.txt"));
+    EXPECT_EQ(cache.evict(), 20u);
+}
+
+TEST_F(ResultCacheTest, EvictRemovesAbandonedTemporaries)
+{
+    ResultCache cache(directory, ".res", 1024);
+    const std::string live = directory + "a.res.tmp" + std::to_string(getpid()) + "_0";
+    const std::string dead = directory + "b.res.tmp999999999_0";
+    const std::string old = directory + "c.res.tmp" + std::to_string(getpid()) + "_1";
+    writeFile(live, "live");
+    writeFile(dead, "dead");
+    writeFile(old, "old");
+    fs::last_write_time(old, fs::file_time_type::clock::now() - ResultCache::STALE_TEMPORARY_AGE -
+                                 std::chrono::minutes(1));
+
+    // The file of a running writer stays, so do the temporary files of other extensions
+    writeFile(directory + "d.other.tmp999999999_0", "other");
+    EXPECT_EQ(cache.evict(), 0u);
+    EXPECT_TRUE(fs::exists(live));
+    EXPECT_FALSE(fs::exists(dead));
+    EXPECT_FALSE(fs::exists(old));
+    EXPECT_TRUE(fs::exists(directory + "d.other.tmp999999999_0"));
+}
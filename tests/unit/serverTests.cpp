@@ -245,6 +245,34 @@ TEST(ServerTest, SuppliesToJson)
     EXPECT_EQ(medicine_json["bandages"], 15);
 }
 
+TEST(ServerTest, SendFileToClientInFrames)
+{
+    Server server(8080, 9090);
+
+    std::string file_path = "/tmp/test_frames.bin";
+    std::string contents(1000, 'e');
+    contents[0] = 'E';
+    std::ofstream(file_path, std::ios::binary) << contents;
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    EXPECT_TRUE(server.sendFileToClient(sockets[0], file_path));
+
+    // One frame with the whole file, then the empty frame ending the stream
+    unsigned char header[CANNY_FRAME_HEADER_BYTES];
+    ASSERT_EQ(recv(sockets[1], header, sizeof(header), MSG_WAITALL), CANNY_FRAME_HEADER_BYTES);
+    EXPECT_EQ((header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3], 1000);
+    std::string received(contents.size(), '\0');
+    ASSERT_EQ(recv(sockets[1], received.data(), received.size(), MSG_WAITALL), 1000);
+    EXPECT_EQ(received, contents);
+    ASSERT_EQ(recv(sockets[1], header, sizeof(header), MSG_WAITALL), CANNY_FRAME_HEADER_BYTES);
+    EXPECT_EQ((header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3], 0);
+
+    close(sockets[0]);
+    close(sockets[1]);
+    fs::remove(file_path);
+}
+
 // Helper function to check if a given string is a valid IP address
 bool isValidIpAddress(const std::string& ip)
 {
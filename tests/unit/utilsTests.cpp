@@ -9,6 +9,8 @@
 #include <iostream>
 #include <regex>
 #include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 TEST(UtilsTest, CreateDirectoriesIfNotExists)
@@ -430,3 +432,57 @@ TEST(CompressImgTest, TestCompressImage)
     fs::remove(temp_txt_path);
     fs::remove(zip_path);
 }
+
+TEST(CompressImgTest, TestParallelChunksDecompressAsOneStream)
+{
+    // Several chunks, the last one partial, and a pattern that differs between chunks
+    std::vector<unsigned char> data(3 * COMPRESS_CHUNK_BYTES + 1000);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<unsigned char>((i * 7 + i / 1000) % 251);
+    }
+
+    std::string zip_path = "/tmp/test_chunks.gz";
+    ASSERT_TRUE(Utils::compressImg(data, zip_path)) << "File compression failed";
+
+    gzFile zipFile = gzopen(zip_path.c_str(), "rb");
+    ASSERT_NE(zipFile, nullptr);
+    std::vector<unsigned char> decompressed(data.size() + 1);
+    int bytes = gzread(zipFile, decompressed.data(), static_cast<unsigned>(decompressed.size()));
+    gzclose(zipFile);
+    ASSERT_EQ(bytes, static_cast<int>(data.size()));
+    decompressed.resize(bytes);
+    EXPECT_TRUE(decompressed == data) << "Decompressed data differs";
+
+    fs::remove(zip_path);
+}
+
+TEST(CompressImgTest, TestGzipChunksStopsOnWriteError)
+{
+    std::vector<unsigned char> data(5 * COMPRESS_CHUNK_BYTES, 'x');
+    int writes = 0;
+    bool result = Utils::gzipChunks(
+        data.data(), data.size(), [&writes](const unsigned char*, size_t) { return ++writes < 2; }, 3);
+
+    EXPECT_FALSE(result);
+    EXPECT_EQ(writes, 2) << "Members were written after a failed write";
+}
+
+TEST(CompressImgTest, TestGzipChunksInForkedChild)
+{
+    std::vector<unsigned char> data(4 * COMPRESS_CHUNK_BYTES, 'y');
+    auto discard = [](const unsigned char*, size_t) { return true; };
+
+    // The parent starts the compression threads first, like the server before the precompute child
+    ASSERT_TRUE(Utils::gzipChunks(data.data(), data.size(), discard));
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0)
+    {
+        alarm(10); // Waiting on the threads of the parent would hang forever
+        _exit(Utils::gzipChunks(data.data(), data.size(), discard) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+}